@@ -0,0 +1,416 @@
+/**************************************************************
+ * async_buffer.h
+ * Bounded buffer for C++20 coroutines, and the small thread pool
+ * that runs them.
+ *
+ *   async_executor pool(4);
+ *   AsyncBoundedBuffer<Job> buffer(64, pool);
+ *
+ *   async_task consume(AsyncBoundedBuffer<Job>& buffer) {
+ *       while (std::optional<Job> job = co_await buffer.pop()) handle(*job);
+ *   }
+ *   pool.spawn(consume(buffer));
+ *   ...
+ *   buffer.close();
+ *   pool.join();
+ *
+ * API:
+ *   co_await push(item)   bool; waits while full, false once closed
+ *   co_await pop()        std::optional<T>; waits while empty, empty
+ *                         once closed and drained
+ *   try_push / try_pop / close / size_approx / capacity as in
+ *   BoundedBuffer, for callers that are not coroutines
+ *
+ * A coroutine that has to wait is parked on the buffer's waiter list
+ * instead of blocking its thread, so thousands of producers and
+ * consumers can share a handful of executor threads. The operation on
+ * the other side completes the parked one itself: push() moves its item
+ * straight into a waiting pop(), pop() refills the ring from a waiting
+ * push(), and the parked coroutine goes onto the executor's ready queue
+ * with its result already in place. Executor threads only sleep in the
+ * kernel when the ready queue is empty.
+ *
+ * The buffer holds pointers to its waiters, so unlike BoundedBuffer it
+ * cannot live in a shared-memory segment.
+ **************************************************************/
+#ifndef ASYNC_BUFFER_H
+#define ASYNC_BUFFER_H
+
+#include <pthread.h>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "bounded_buffer.h"
+
+class async_executor;
+
+// Fire-and-forget coroutine. It does not start until it is spawned on
+// an executor, and frees itself when it returns.
+class async_task {
+public:
+    struct promise_type {
+        async_executor* executor = nullptr;
+
+        async_task get_return_object() {
+            return async_task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never  final_suspend() noexcept;
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    async_task(async_task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    ~async_task() {
+        if (handle) handle.destroy();  // never spawned
+    }
+
+    async_task(const async_task&) = delete;
+    async_task& operator=(const async_task&) = delete;
+
+private:
+    friend class async_executor;
+
+    explicit async_task(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+
+// Fixed pool of threads resuming coroutines from one FIFO ready queue
+class async_executor {
+public:
+    explicit async_executor(int num_threads) {
+        pthread_mutex_init(&lock, nullptr);
+        pthread_cond_init(&work_ready, nullptr);
+        pthread_cond_init(&all_done, nullptr);
+        for (int i = 0; i < (num_threads > 0 ? num_threads : 1); ++i)
+            threads.emplace_back(&async_executor::run, this);
+    }
+
+    ~async_executor() {
+        join();
+        pthread_cond_destroy(&all_done);
+        pthread_cond_destroy(&work_ready);
+        pthread_mutex_destroy(&lock);
+    }
+
+    async_executor(const async_executor&) = delete;
+    async_executor& operator=(const async_executor&) = delete;
+
+    int num_threads() const { return static_cast<int>(threads.size()); }
+
+    // Start a task on the pool
+    void spawn(async_task task) {
+        std::coroutine_handle<async_task::promise_type> h = std::exchange(task.handle, nullptr);
+        h.promise().executor = this;
+        pthread_mutex_lock(&lock);
+        ++live_tasks;
+        pthread_mutex_unlock(&lock);
+        schedule(h);
+    }
+
+    // Queue a suspended coroutine to be resumed on one of the threads
+    void schedule(std::coroutine_handle<> h) {
+        pthread_mutex_lock(&lock);
+        ready.push_back(h);
+        if (idle_threads) pthread_cond_signal(&work_ready);
+        pthread_mutex_unlock(&lock);
+    }
+
+    // Wait until every spawned task has returned, then stop the threads.
+    // Whatever the tasks wait on must be closed first.
+    void join() {
+        pthread_mutex_lock(&lock);
+        while (live_tasks > 0) pthread_cond_wait(&all_done, &lock);
+        stopping = true;
+        pthread_cond_broadcast(&work_ready);
+        pthread_mutex_unlock(&lock);
+        for (auto& t : threads)
+            if (t.joinable()) t.join();
+    }
+
+private:
+    friend struct async_task::promise_type;
+
+    void task_finished() {
+        pthread_mutex_lock(&lock);
+        if (--live_tasks == 0) pthread_cond_broadcast(&all_done);
+        pthread_mutex_unlock(&lock);
+    }
+
+    void run() {
+        pthread_mutex_lock(&lock);
+        while (true) {
+            while (ready.empty() && !stopping) {
+                ++idle_threads;
+                pthread_cond_wait(&work_ready, &lock);
+                --idle_threads;
+            }
+            if (ready.empty()) break;
+            std::coroutine_handle<> h = ready.front();
+            ready.pop_front();
+            pthread_mutex_unlock(&lock);
+            h.resume();
+            pthread_mutex_lock(&lock);
+        }
+        pthread_mutex_unlock(&lock);
+    }
+
+    pthread_mutex_t lock;
+    pthread_cond_t  work_ready;
+    pthread_cond_t  all_done;
+    std::deque<std::coroutine_handle<>> ready;
+    std::vector<std::thread> threads;
+    long live_tasks   = 0;
+    int  idle_threads = 0;
+    bool stopping     = false;
+};
+
+inline std::suspend_never async_task::promise_type::final_suspend() noexcept {
+    executor->task_finished();
+    return {};
+}
+
+
+namespace async_buffer_detail {
+
+// Intrusive FIFO of parked awaiters, linked through their `next` field
+template <typename Waiter>
+class waiter_list {
+public:
+    bool empty() const { return head == nullptr; }
+
+    void push_back(Waiter* w) {
+        w->next = nullptr;
+        if (tail) tail->next = w;
+        else      head = w;
+        tail = w;
+    }
+
+    Waiter* pop_front() {
+        Waiter* w = head;
+        if (w) {
+            head = w->next;
+            if (!head) tail = nullptr;
+        }
+        return w;
+    }
+
+    // Detach the whole list and return its first element
+    Waiter* take_all() {
+        Waiter* w = head;
+        head = tail = nullptr;
+        return w;
+    }
+
+private:
+    Waiter* head = nullptr;
+    Waiter* tail = nullptr;
+};
+
+} // namespace async_buffer_detail
+
+
+template <typename T>
+class AsyncBoundedBuffer {
+public:
+    class push_awaiter {
+    public:
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h) { return buffer.suspend_push(this, h); }
+        bool await_resume() const noexcept { return ok; }
+
+    private:
+        friend class AsyncBoundedBuffer;
+        friend class async_buffer_detail::waiter_list<push_awaiter>;
+
+        push_awaiter(AsyncBoundedBuffer& buffer, T&& item) : buffer(buffer), item(std::move(item)) {}
+
+        AsyncBoundedBuffer&     buffer;
+        T                       item;
+        bool                    ok = false;
+        std::coroutine_handle<> handle;
+        push_awaiter*           next = nullptr;
+    };
+
+    class pop_awaiter {
+    public:
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h) { return buffer.suspend_pop(this, h); }
+        std::optional<T> await_resume() { return std::move(value); }
+
+    private:
+        friend class AsyncBoundedBuffer;
+        friend class async_buffer_detail::waiter_list<pop_awaiter>;
+
+        explicit pop_awaiter(AsyncBoundedBuffer& buffer) : buffer(buffer) {}
+
+        AsyncBoundedBuffer&     buffer;
+        std::optional<T>        value;
+        std::coroutine_handle<> handle;
+        pop_awaiter*            next = nullptr;
+    };
+
+    AsyncBoundedBuffer(size_t capacity, async_executor& executor)
+        : slots(capacity), executor(executor) {
+        pthread_mutex_init(&lock, nullptr);
+    }
+
+    ~AsyncBoundedBuffer() { pthread_mutex_destroy(&lock); }
+
+    AsyncBoundedBuffer(const AsyncBoundedBuffer&) = delete;
+    AsyncBoundedBuffer& operator=(const AsyncBoundedBuffer&) = delete;
+
+    push_awaiter push(T item) { return push_awaiter(*this, std::move(item)); }
+    pop_awaiter  pop()        { return pop_awaiter(*this); }
+
+    bool try_push(T&& item) {
+        pthread_mutex_lock(&lock);
+        if (closed || (count == slots.size() && poppers.empty())) {
+            pthread_mutex_unlock(&lock);
+            return false;
+        }
+        pop_awaiter* r = poppers.pop_front();
+        if (r) r->value.emplace(std::move(item));
+        else   put(std::move(item));
+        pthread_mutex_unlock(&lock);
+        if (r) executor.schedule(r->handle);
+        return true;
+    }
+
+    bool try_pop(T& out) {
+        pthread_mutex_lock(&lock);
+        if (count == 0) {
+            pthread_mutex_unlock(&lock);
+            return false;
+        }
+        out = take();
+        push_awaiter* w = refill();
+        pthread_mutex_unlock(&lock);
+        if (w) executor.schedule(w->handle);
+        return true;
+    }
+
+    // Fail every parked push(), and every parked pop() once drained
+    void close() {
+        pthread_mutex_lock(&lock);
+        closed = true;
+        push_awaiter* w = pushers.take_all();
+        pop_awaiter*  r = poppers.take_all();  // only parked while empty
+        pthread_mutex_unlock(&lock);
+
+        // read next before scheduling: a resumed awaiter is gone
+        while (w) {
+            push_awaiter* next = w->next;
+            w->ok = false;
+            executor.schedule(w->handle);
+            w = next;
+        }
+        while (r) {
+            pop_awaiter* next = r->next;
+            executor.schedule(r->handle);
+            r = next;
+        }
+    }
+
+    size_t size_approx() {
+        pthread_mutex_lock(&lock);
+        size_t n = count;
+        pthread_mutex_unlock(&lock);
+        return n;
+    }
+
+    size_t capacity() const { return slots.size(); }
+
+private:
+    // Returns false when the push completed without waiting
+    bool suspend_push(push_awaiter* w, std::coroutine_handle<> h) {
+        pthread_mutex_lock(&lock);
+        if (closed) {
+            pthread_mutex_unlock(&lock);
+            return false;
+        }
+        if (pop_awaiter* r = poppers.pop_front()) {
+            // hand the item straight to a waiting consumer
+            r->value.emplace(std::move(w->item));
+            pthread_mutex_unlock(&lock);
+            w->ok = true;
+            executor.schedule(r->handle);
+            return false;
+        }
+        if (count < slots.size()) {
+            put(std::move(w->item));
+            pthread_mutex_unlock(&lock);
+            w->ok = true;
+            return false;
+        }
+        w->handle = h;
+        pushers.push_back(w);
+        pthread_mutex_unlock(&lock);
+        return true;
+    }
+
+    // Returns false when the pop completed without waiting
+    bool suspend_pop(pop_awaiter* r, std::coroutine_handle<> h) {
+        pthread_mutex_lock(&lock);
+        if (count > 0) {
+            r->value.emplace(take());
+            push_awaiter* w = refill();
+            pthread_mutex_unlock(&lock);
+            if (w) executor.schedule(w->handle);
+            return false;
+        }
+        if (closed) {
+            pthread_mutex_unlock(&lock);
+            return false;
+        }
+        r->handle = h;
+        poppers.push_back(r);
+        pthread_mutex_unlock(&lock);
+        return true;
+    }
+
+    // the ring, under lock
+    void put(T&& item) {
+        slots[in] = std::move(item);
+        in = (in + 1) % slots.size();
+        ++count;
+    }
+
+    T take() {
+        T item = std::move(slots[out_index]);
+        out_index = (out_index + 1) % slots.size();
+        --count;
+        return item;
+    }
+
+    // Move a parked producer's item into the slot just freed; the caller
+    // schedules the returned awaiter after unlocking
+    push_awaiter* refill() {
+        push_awaiter* w = pushers.pop_front();
+        if (w) {
+            put(std::move(w->item));
+            w->ok = true;
+        }
+        return w;
+    }
+
+    bounded_buffer_detail::slot_storage<T, dynamic_capacity> slots;
+    size_t in = 0;
+    size_t out_index = 0;
+    size_t count = 0;
+    bool   closed = false;
+
+    pthread_mutex_t lock;
+    async_buffer_detail::waiter_list<push_awaiter> pushers;  // only while full
+    async_buffer_detail::waiter_list<pop_awaiter>  poppers;  // only while empty
+    async_executor& executor;
+};
+
+#endif // ASYNC_BUFFER_H
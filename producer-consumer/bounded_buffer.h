@@ -0,0 +1,407 @@
+/**************************************************************
+ * bounded_buffer.h
+ * Header-only bounded buffer:
+ *
+ *   BoundedBuffer<T, Capacity, SyncPolicy>
+ *
+ *   T           element type; must be default-constructible and
+ *               move-assignable. Elements are moved in and out,
+ *               never copied.
+ *   Capacity    number of slots, fixed at compile time, or
+ *               dynamic_capacity (0) to pass it to the constructor.
+ *   SyncPolicy  how producers and consumers synchronize:
+ *     MutexSemaphorePolicy  one mutex plus "empty" and "full" counting
+ *                           semaphores (the classic textbook scheme);
+ *                           any number of producers and consumers
+ *     SpscPolicy            lock-free, exactly one producer thread and
+ *                           one consumer thread
+ *     MpmcPolicy            lock-free, any number of producers and
+ *                           consumers (per-slot sequence numbers);
+ *                           needs at least 2 slots
+ *
+ * API (identical for every policy):
+ *   bool try_push(T&& item)  false if full or closed; item untouched
+ *   bool try_pop(T& out)     false if empty
+ *   bool push(T&& item)      blocks while full; false once closed
+ *   bool pop(T& out)         blocks while empty; false once closed
+ *                            and drained
+ *   void close()             wakes every blocked push()/pop()
+ *   size_t size_approx()     items currently held; a snapshot that may
+ *                            already be stale when it is returned
+ *
+ * The lock-free policies block by spinning with backoff, never in
+ * the kernel. A fixed-capacity buffer holds no pointers, so it can be
+ * placement-new'ed into a shared-memory segment; the semaphores and
+ * mutex of MutexSemaphorePolicy are created process-shared for that.
+ **************************************************************/
+#ifndef BOUNDED_BUFFER_H
+#define BOUNDED_BUFFER_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <utility>
+
+constexpr size_t dynamic_capacity = 0;
+
+namespace bounded_buffer_detail {
+
+// Slot array: inline for a compile-time capacity, on the heap otherwise
+template <typename Slot, size_t Capacity>
+class slot_storage {
+public:
+    explicit slot_storage(size_t) {}
+    size_t size() const { return Capacity; }
+    Slot& operator[](size_t i) { return slots[i]; }
+
+private:
+    std::array<Slot, Capacity> slots;
+};
+
+template <typename Slot>
+class slot_storage<Slot, dynamic_capacity> {
+public:
+    explicit slot_storage(size_t capacity) : slots(new Slot[capacity]), count(capacity) {
+        assert(capacity > 0 && "BoundedBuffer needs at least one slot");
+    }
+    size_t size() const { return count; }
+    Slot& operator[](size_t i) { return slots[i]; }
+
+private:
+    std::unique_ptr<Slot[]> slots;
+    size_t count;
+};
+
+// Spin briefly, then give the cpu away
+class backoff {
+public:
+    void pause() {
+        if (spins < 64) {
+            ++spins;
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    int spins = 0;
+};
+
+} // namespace bounded_buffer_detail
+
+
+// One mutex guarding the ring, plus counting semaphores for free and
+// used slots. close() posts one token on each semaphore; every waiter
+// that wakes up to a closed buffer passes the token on.
+struct MutexSemaphorePolicy {
+    template <typename T, size_t Capacity>
+    class queue {
+    public:
+        explicit queue(size_t capacity) : slots(capacity) {
+            pthread_mutexattr_t attr;
+            pthread_mutexattr_init(&attr);
+            pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+            pthread_mutex_init(&lock, &attr);
+            pthread_mutexattr_destroy(&attr);
+            sem_init(&empty_slots, 1, static_cast<unsigned>(slots.size()));
+            sem_init(&full_slots,  1, 0);
+        }
+
+        ~queue() {
+            sem_destroy(&full_slots);
+            sem_destroy(&empty_slots);
+            pthread_mutex_destroy(&lock);
+        }
+
+        bool try_push(T&& item) {
+            if (sem_trywait(&empty_slots) != 0) return false;
+            return insert(std::move(item));
+        }
+
+        bool try_pop(T& out) {
+            if (sem_trywait(&full_slots) != 0) return false;
+            return remove(out);
+        }
+
+        bool push(T&& item) {
+            while (sem_wait(&empty_slots) != 0) {}
+            return insert(std::move(item));
+        }
+
+        bool pop(T& out) {
+            while (sem_wait(&full_slots) != 0) {}
+            return remove(out);
+        }
+
+        void close() {
+            pthread_mutex_lock(&lock);
+            closed = true;
+            pthread_mutex_unlock(&lock);
+            sem_post(&empty_slots);
+            sem_post(&full_slots);
+        }
+
+        size_t size_approx() {
+            pthread_mutex_lock(&lock);
+            size_t n = count;
+            pthread_mutex_unlock(&lock);
+            return n;
+        }
+
+        size_t capacity() const { return slots.size(); }
+
+    private:
+        // called holding an empty_slots token
+        bool insert(T&& item) {
+            pthread_mutex_lock(&lock);
+            if (closed) {
+                pthread_mutex_unlock(&lock);
+                sem_post(&empty_slots);  // pass the wakeup on
+                return false;
+            }
+            slots[in] = std::move(item);
+            in = (in + 1) % slots.size();
+            ++count;
+            pthread_mutex_unlock(&lock);
+            sem_post(&full_slots);
+            return true;
+        }
+
+        // called holding a full_slots token; drains before reporting closed
+        bool remove(T& out) {
+            pthread_mutex_lock(&lock);
+            if (count == 0) {
+                pthread_mutex_unlock(&lock);
+                sem_post(&full_slots);   // the close token: pass it on
+                return false;
+            }
+            out = std::move(slots[out_index]);
+            out_index = (out_index + 1) % slots.size();
+            --count;
+            pthread_mutex_unlock(&lock);
+            sem_post(&empty_slots);
+            return true;
+        }
+
+        bounded_buffer_detail::slot_storage<T, Capacity> slots;
+        size_t in = 0;
+        size_t out_index = 0;
+        size_t count = 0;
+        bool   closed = false;
+
+        pthread_mutex_t lock;
+        sem_t empty_slots;
+        sem_t full_slots;
+    };
+};
+
+
+// Single producer, single consumer. head and tail only grow; each side
+// keeps a cached copy of the other's index so the shared cache line is
+// only read when the cached value says the ring looks full / empty.
+struct SpscPolicy {
+    template <typename T, size_t Capacity>
+    class queue {
+    public:
+        explicit queue(size_t capacity) : slots(capacity) {}
+
+        bool try_push(T&& item) {
+            if (closed.load(std::memory_order_relaxed)) return false;
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t - head_cache == slots.size()) {
+                head_cache = head.load(std::memory_order_acquire);
+                if (t - head_cache == slots.size()) return false;
+            }
+            slots[t % slots.size()] = std::move(item);
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop(T& out) {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail_cache) {
+                tail_cache = tail.load(std::memory_order_acquire);
+                if (h == tail_cache) return false;
+            }
+            out = std::move(slots[h % slots.size()]);
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool push(T&& item) {
+            bounded_buffer_detail::backoff wait;
+            while (!closed.load(std::memory_order_relaxed)) {
+                if (try_push(std::move(item))) return true;
+                wait.pause();
+            }
+            return false;
+        }
+
+        bool pop(T& out) {
+            bounded_buffer_detail::backoff wait;
+            while (!try_pop(out)) {
+                if (closed.load(std::memory_order_acquire)) return try_pop(out);
+                wait.pause();
+            }
+            return true;
+        }
+
+        void close() { closed.store(true, std::memory_order_release); }
+
+        size_t size_approx() const {
+            size_t h = head.load(std::memory_order_acquire);
+            size_t t = tail.load(std::memory_order_acquire);
+            return t > h ? t - h : 0;
+        }
+
+        size_t capacity() const { return slots.size(); }
+
+    private:
+        // consumer side
+        alignas(64) std::atomic<size_t> head{0};
+        size_t tail_cache = 0;
+        // producer side
+        alignas(64) std::atomic<size_t> tail{0};
+        size_t head_cache = 0;
+
+        alignas(64) std::atomic<bool> closed{false};
+        bounded_buffer_detail::slot_storage<T, Capacity> slots;
+    };
+};
+
+
+// Multi-producer, multi-consumer (Vyukov's bounded queue). Each slot
+// carries a sequence number telling whether it is ready for the push
+// or the pop at a given position, so producers and consumers only
+// contend on their own position counter.
+struct MpmcPolicy {
+    template <typename T, size_t Capacity>
+    class queue {
+        // with one cell, "ready for the pop at pos" and "ready for the
+        // push at pos + 1" are the same sequence number
+        static_assert(Capacity == dynamic_capacity || Capacity >= 2,
+                      "MpmcPolicy needs at least 2 slots");
+
+    public:
+        explicit queue(size_t capacity) : cells(capacity) {
+            // checked in release builds too: one cell never reports full
+            // and the second push overwrites the first item
+            if (cells.size() < 2) {
+                fprintf(stderr, "MpmcPolicy needs at least 2 slots, got %zu\n", cells.size());
+                abort();
+            }
+            for (size_t i = 0; i < cells.size(); ++i)
+                cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        bool try_push(T&& item) {
+            if (closed.load(std::memory_order_relaxed)) return false;
+            size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+            cell* c;
+            while (true) {
+                c = &cells[pos % cells.size()];
+                size_t seq = c->seq.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if (diff < 0) {
+                    return false;  // full
+                } else {
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+            c->data = std::move(item);
+            c->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop(T& out) {
+            size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+            cell* c;
+            while (true) {
+                c = &cells[pos % cells.size()];
+                size_t seq = c->seq.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if (diff < 0) {
+                    return false;  // empty
+                } else {
+                    pos = dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+            out = std::move(c->data);
+            c->seq.store(pos + cells.size(), std::memory_order_release);
+            return true;
+        }
+
+        bool push(T&& item) {
+            bounded_buffer_detail::backoff wait;
+            while (!closed.load(std::memory_order_relaxed)) {
+                if (try_push(std::move(item))) return true;
+                wait.pause();
+            }
+            return false;
+        }
+
+        bool pop(T& out) {
+            bounded_buffer_detail::backoff wait;
+            while (!try_pop(out)) {
+                if (closed.load(std::memory_order_acquire)) return try_pop(out);
+                wait.pause();
+            }
+            return true;
+        }
+
+        void close() { closed.store(true, std::memory_order_release); }
+
+        size_t size_approx() const {
+            size_t d = dequeue_pos.load(std::memory_order_acquire);
+            size_t e = enqueue_pos.load(std::memory_order_acquire);
+            if (e <= d) return 0;
+            return e - d < cells.size() ? e - d : cells.size();
+        }
+
+        size_t capacity() const { return cells.size(); }
+
+    private:
+        struct cell {
+            std::atomic<size_t> seq;
+            T data;
+        };
+
+        alignas(64) std::atomic<size_t> enqueue_pos{0};
+        alignas(64) std::atomic<size_t> dequeue_pos{0};
+        alignas(64) std::atomic<bool>   closed{false};
+        bounded_buffer_detail::slot_storage<cell, Capacity> cells;
+    };
+};
+
+
+template <typename T, size_t Capacity = dynamic_capacity,
+          typename SyncPolicy = MutexSemaphorePolicy>
+class BoundedBuffer : public SyncPolicy::template queue<T, Capacity> {
+public:
+    explicit BoundedBuffer(size_t capacity = Capacity)
+        : SyncPolicy::template queue<T, Capacity>(capacity) {}
+
+    BoundedBuffer(const BoundedBuffer&) = delete;
+    BoundedBuffer& operator=(const BoundedBuffer&) = delete;
+};
+
+#endif // BOUNDED_BUFFER_H
@@ -0,0 +1,326 @@
+/**************************************************************
+ * byte_ring.h
+ * Variable-length, zero-copy record ring in POSIX shared memory.
+ *
+ * Producers claim N bytes, write the record in place and commit it.
+ * Consumers acquire a view of the oldest committed record, read it in
+ * place and release it. Nothing is copied between the two.
+ *
+ * Layout of the shared segment:
+ *
+ *   | byte_ring (control block) | data[capacity] |
+ *
+ * Every record in data[] starts with a 16-byte record_header holding
+ * the payload length and state, and occupies a multiple of 16 bytes,
+ * so every payload is 16-byte aligned. A record never wraps: when it
+ * does not fit before the end of data[], a padding record fills the
+ * tail and the record starts again at offset 0.
+ *
+ * Positions are 64-bit byte offsets that only grow; the slot in
+ * data[] is position % capacity.
+ *
+ *   free_pos <= read_pos <= write_pos <= free_pos + capacity
+ *
+ *   [free_pos, read_pos)   handed to consumers, not yet all released
+ *   [read_pos, write_pos)  claimed by producers (writing or committed)
+ *
+ * The control block uses a process-shared mutex and two condition
+ * variables, so the ring can also be attached from another process.
+ **************************************************************/
+#ifndef BYTE_RING_H
+#define BYTE_RING_H
+
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// What a consumer sees: the payload in place, valid until release()
+struct record_view {
+    void*    data;
+    uint32_t length;
+};
+
+class byte_ring {
+public:
+    static const uint32_t RECORD_ALIGN = 16;
+
+    // Create (or replace) the named segment with room for `capacity` bytes
+    // of records; returns nullptr on failure
+    static byte_ring* create(const char* name, size_t capacity) {
+        capacity = align_up(capacity);
+        size_t size = control_size() + capacity;
+
+        shm_unlink(name);
+        int fd = shm_open(name, O_CREAT | O_RDWR, 0666);
+        if (fd == -1) return nullptr;
+        if (ftruncate(fd, size) == -1) {
+            close(fd);
+            return nullptr;
+        }
+        void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mem == MAP_FAILED) return nullptr;
+
+        // touch every page from the calling thread (first-touch placement)
+        memset(mem, 0, size);
+
+        byte_ring* ring = static_cast<byte_ring*>(mem);
+        ring->init(capacity, size);
+        return ring;
+    }
+
+    // Map an existing segment created by create(); returns nullptr on failure
+    static byte_ring* attach(const char* name) {
+        int fd = shm_open(name, O_RDWR, 0666);
+        if (fd == -1) return nullptr;
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            close(fd);
+            return nullptr;
+        }
+        void* mem = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        return mem == MAP_FAILED ? nullptr : static_cast<byte_ring*>(mem);
+    }
+
+    // Unmap this process's view of the ring
+    static void detach(byte_ring* ring) {
+        munmap(ring, ring->mapped_size);
+    }
+
+    // Tear down the synchronization objects and remove the segment name;
+    // call once, after every user has stopped
+    static void destroy(byte_ring* ring, const char* name) {
+        pthread_cond_destroy(&ring->not_full);
+        pthread_cond_destroy(&ring->not_empty);
+        pthread_mutex_destroy(&ring->lock);
+        detach(ring);
+        shm_unlink(name);
+    }
+
+    // Reserve `length` bytes for one record and return where to write it.
+    // Blocks while the ring is full; returns nullptr if the record can
+    // never fit or the ring has been shut down.
+    void* claim(uint32_t length) {
+        uint64_t total = record_size(length);
+        if (total > capacity) return nullptr;
+
+        pthread_mutex_lock(&lock);
+        while (!stopped) {
+            // bytes left before the end of data[]; a record must not wrap
+            uint64_t tail_room = capacity - write_pos % capacity;
+            if (tail_room >= total) {
+                if (write_pos + total - free_pos <= capacity) break;
+            } else if (write_pos + tail_room - free_pos <= capacity) {
+                // pad the tail on its own, then wait for room at offset 0
+                pad_tail(tail_room);
+                continue;
+            }
+            pthread_cond_wait(&not_full, &lock);
+        }
+        if (stopped) {
+            pthread_mutex_unlock(&lock);
+            return nullptr;
+        }
+
+        record_header* h = header_at(write_pos);
+        h->length = length;
+        h->state  = STATE_WRITING;
+        write_pos += total;
+        pthread_mutex_unlock(&lock);
+
+        return h + 1;
+    }
+
+    // Publish a record returned by claim()
+    void commit(void* payload) {
+        record_header* h = static_cast<record_header*>(payload) - 1;
+        pthread_mutex_lock(&lock);
+        h->state = STATE_COMMITTED;
+        ++committed;
+        committed_bytes += h->length;
+        pthread_cond_broadcast(&not_empty);
+        pthread_mutex_unlock(&lock);
+    }
+
+    // Take the oldest record. Records are handed out in claim order, so
+    // this blocks until that record is committed. Returns false once the
+    // ring has been shut down.
+    bool acquire(record_view* view) {
+        pthread_mutex_lock(&lock);
+        while (!stopped) {
+            if (read_pos != write_pos) {
+                record_header* h = header_at(read_pos);
+                if (h->state == STATE_PADDING) {
+                    read_pos += record_total(h);
+                    reclaim();
+                    continue;
+                }
+                if (h->state == STATE_COMMITTED) {
+                    h->state = STATE_READING;
+                    read_pos += record_total(h);
+                    pthread_mutex_unlock(&lock);
+                    view->data   = h + 1;
+                    view->length = h->length;
+                    return true;
+                }
+            }
+            pthread_cond_wait(&not_empty, &lock);
+        }
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    // Give a record's space back. Space is reclaimed in ring order, so an
+    // early release only frees memory once every older record is released.
+    void release(const record_view& view) {
+        record_header* h = static_cast<record_header*>(view.data) - 1;
+        pthread_mutex_lock(&lock);
+        h->state = STATE_RELEASED;
+        ++released;
+        released_bytes += h->length;
+        reclaim();
+        pthread_mutex_unlock(&lock);
+    }
+
+    // Wake every blocked claim()/acquire() and make them fail from now on
+    void shutdown() {
+        pthread_mutex_lock(&lock);
+        stopped = true;
+        pthread_cond_broadcast(&not_full);
+        pthread_cond_broadcast(&not_empty);
+        pthread_mutex_unlock(&lock);
+    }
+
+    // Records and payload bytes committed / released so far
+    void counters(uint64_t* n_committed, uint64_t* n_released,
+                  uint64_t* n_committed_bytes, uint64_t* n_released_bytes) {
+        pthread_mutex_lock(&lock);
+        *n_committed       = committed;
+        *n_released        = released;
+        *n_committed_bytes = committed_bytes;
+        *n_released_bytes  = released_bytes;
+        pthread_mutex_unlock(&lock);
+    }
+
+    size_t data_capacity() const { return capacity; }
+
+    // Largest payload a single record can carry
+    size_t max_record() const { return capacity - sizeof(record_header); }
+
+private:
+    enum : uint32_t {
+        STATE_WRITING   = 1,
+        STATE_COMMITTED = 2,
+        STATE_READING   = 3,
+        STATE_RELEASED  = 4,
+        STATE_PADDING   = 5
+    };
+
+    struct record_header {
+        uint32_t length;    // payload bytes
+        uint32_t state;
+        uint64_t reserved;  // keeps the payload 16-byte aligned
+    };
+    static_assert(sizeof(record_header) == RECORD_ALIGN, "record header must be one alignment unit");
+
+    static uint64_t align_up(uint64_t n) {
+        return (n + RECORD_ALIGN - 1) & ~static_cast<uint64_t>(RECORD_ALIGN - 1);
+    }
+
+    static uint64_t record_size(uint32_t length) {
+        return align_up(sizeof(record_header) + static_cast<uint64_t>(length));
+    }
+
+    // data[] starts on its own cache line after the control block
+    static size_t control_size() {
+        return (sizeof(byte_ring) + 63) & ~static_cast<size_t>(63);
+    }
+
+    uint64_t record_total(const record_header* h) const {
+        return record_size(h->length);
+    }
+
+    // Move free_pos over released and padding records handed out so
+    // far; called with the lock held
+    void reclaim() {
+        uint64_t old_free = free_pos;
+        while (free_pos < read_pos) {
+            record_header* f = header_at(free_pos);
+            if (f->state != STATE_RELEASED && f->state != STATE_PADDING) break;
+            free_pos += record_total(f);
+        }
+        if (free_pos != old_free) pthread_cond_broadcast(&not_full);
+    }
+
+    // Fill the `pad` bytes before the end of data[] with a padding
+    // record; called with the lock held and `pad` bytes free. When every
+    // consumer has caught up, the padding is skipped and reclaimed at
+    // once, so a record waiting for offset 0 does not wait for a reader.
+    void pad_tail(uint64_t pad) {
+        record_header* h = header_at(write_pos);
+        h->length = static_cast<uint32_t>(pad - sizeof(record_header));
+        h->state  = STATE_PADDING;
+        bool caught_up = read_pos == write_pos;
+        write_pos += pad;
+        if (caught_up) {
+            read_pos = write_pos;
+            reclaim();
+        }
+    }
+
+    record_header* header_at(uint64_t pos) {
+        char* data = reinterpret_cast<char*>(this) + control_size();
+        return reinterpret_cast<record_header*>(data + pos % capacity);
+    }
+
+    void init(size_t cap, size_t size) {
+        pthread_mutexattr_t mattr;
+        pthread_mutexattr_init(&mattr);
+        pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+        pthread_mutex_init(&lock, &mattr);
+        pthread_mutexattr_destroy(&mattr);
+
+        pthread_condattr_t cattr;
+        pthread_condattr_init(&cattr);
+        pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+        pthread_cond_init(&not_full, &cattr);
+        pthread_cond_init(&not_empty, &cattr);
+        pthread_condattr_destroy(&cattr);
+
+        capacity    = cap;
+        mapped_size = size;
+        write_pos = read_pos = free_pos = 0;
+        committed = released = committed_bytes = released_bytes = 0;
+        stopped = false;
+    }
+
+    // Synchronization (process-shared)
+    pthread_mutex_t lock;
+    pthread_cond_t  not_full;
+    pthread_cond_t  not_empty;
+
+    // Geometry
+    uint64_t capacity;
+    uint64_t mapped_size;
+
+    // Positions (protected by lock)
+    uint64_t write_pos;
+    uint64_t read_pos;
+    uint64_t free_pos;
+
+    // Counters (protected by lock)
+    uint64_t committed;
+    uint64_t released;
+    uint64_t committed_bytes;
+    uint64_t released_bytes;
+
+    bool stopped;
+};
+
+#endif // BYTE_RING_H
@@ -0,0 +1,711 @@
+/**************************************************************
+ * journal.h
+ * Durable record queue: an append-only log of memory-mapped segment
+ * files plus a small metadata file, made durable by group commit.
+ *
+ * Layout of the journal directory:
+ *
+ *   journal.meta                 magic, geometry and two checkpoints
+ *   00000000000000000000.seg     segment files of segment_size bytes,
+ *   00000000000016777216.seg     named by the log offset they start at
+ *
+ * Offsets are 64-bit byte positions in the log that only grow. A
+ * record is an 8-byte header followed by the payload, padded to 8
+ * bytes. A record never crosses a segment boundary: an end-of-segment
+ * marker fills the rest of the segment and the record goes to the
+ * start of the next one.
+ *
+ * Producers append() into the mapped segment. Consumers never see a
+ * record before a group commit has made it durable:
+ *
+ *   1. msync() the log bytes appended since the last commit
+ *   2. write the new durable end and every group's consumer offset
+ *      into the older checkpoint slot, then msync() the metadata
+ *
+ * A background thread commits every commit_interval seconds, or sooner
+ * once commit_bytes are pending, so one sync covers many appends. The
+ * directory is fsync()ed before the first checkpoint that covers a new
+ * segment file, so the file cannot vanish in a crash.
+ *
+ * A failed sync is final: the checkpoint is not written, nothing more
+ * becomes visible to consumers, and append() and acquire() fail from
+ * then on with the cause in error(). The same happens when a record
+ * below the durable end turns out to be missing or damaged; it is never
+ * handed out.
+ *
+ * Consumers belong to groups. Each group reads the whole log; the
+ * consumers inside one group share it, each record going to one of
+ * them. acquire() hands out a record in place; release() marks it
+ * processed. A group's offset only moves past released records, in log
+ * order, and is saved by the next commit.
+ *
+ * Recovery: open() on an existing directory takes the newest valid
+ * checkpoint, drops everything appended after its durable end and puts
+ * each group back at its saved offset. Records that were handed out
+ * but whose release was not committed before a crash are delivered
+ * again (at-least-once). If journal.meta exists but has a bad header or
+ * no valid checkpoint, open() fails with EBADMSG and leaves the
+ * segments alone; only a directory without journal.meta starts a new
+ * log.
+ *
+ * Segments wholly below every group's saved offset are deleted at
+ * commit time, and append() blocks while `capacity` bytes are waiting
+ * for the slowest group, so the log stays bounded like the rings.
+ **************************************************************/
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <pthread.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct journal_options {
+    uint64_t segment_size    = 16 << 20;    // fixed when the journal is created
+    uint64_t capacity        = 256 << 20;   // appended bytes not yet released by every group
+    double   commit_interval = 0.01;        // seconds between commits; 0 = by bytes only
+    uint64_t commit_bytes    = 1 << 20;     // commit early at this many pending bytes; 0 = by time only
+    int      groups          = 1;           // consumer groups; fixed when the journal is created
+};
+
+// A record handed to a consumer, valid until release()
+struct journal_record {
+    const void* data;
+    uint32_t    length;
+    uint64_t    offset;   // log position of the record
+};
+
+struct journal_stats {
+    uint64_t appended;
+    uint64_t appended_bytes;
+    uint64_t commits;         // commits that synced anything
+    uint64_t synced_bytes;    // log bytes made durable
+    double   sync_seconds;    // time spent in msync()
+};
+
+class journal {
+public:
+    static const int MAX_GROUPS = 8;
+
+    // Open the journal in `dir`, creating it if needed. An existing
+    // journal keeps its own segment size and group count. Returns nullptr
+    // on failure (errno is set).
+    static journal* open(const std::string& dir, const journal_options& options) {
+        journal* j = new journal(dir, options);
+        if (!j->recover()) {
+            int saved = errno;
+            delete j;
+            errno = saved;
+            return nullptr;
+        }
+        j->committer = std::thread(&journal::commit_loop, j);
+        return j;
+    }
+
+    // Delete every file of the journal in `dir`
+    static void remove(const std::string& dir) {
+        DIR* d = opendir(dir.c_str());
+        if (d == nullptr) return;
+        while (dirent* e = readdir(d)) {
+            std::string name = e->d_name;
+            if (name == "journal.meta" || name == "journal.meta.new" || is_segment_name(name))
+                unlink((dir + "/" + name).c_str());
+        }
+        closedir(d);
+        rmdir(dir.c_str());
+    }
+
+    // Stops the committer, commits what is left and unmaps everything
+    ~journal() {
+        shutdown();
+        if (committer.joinable()) {
+            pthread_mutex_lock(&lock);
+            committer_stop = true;
+            pthread_cond_signal(&commit_wanted);
+            pthread_mutex_unlock(&lock);
+            committer.join();
+        }
+        if (meta != nullptr) commit();
+
+        for (auto& s : segments) unmap_segment(s.second);
+        if (meta != nullptr) munmap(meta, META_SIZE);
+        if (meta_fd >= 0) ::close(meta_fd);
+
+        pthread_cond_destroy(&commit_wanted);
+        pthread_cond_destroy(&not_full);
+        pthread_cond_destroy(&readable);
+        pthread_mutex_destroy(&commit_lock);
+        pthread_mutex_destroy(&lock);
+    }
+
+    journal(const journal&) = delete;
+    journal& operator=(const journal&) = delete;
+
+    // Copy one record to the end of the log. Blocks while the log is at
+    // capacity; returns false if the record can never fit, a segment
+    // cannot be created, a commit has failed, or the journal has been
+    // shut down.
+    bool append(const void* data, uint32_t length) {
+        uint64_t total = record_size(length);
+        if (total > options.segment_size) return false;
+
+        pthread_mutex_lock(&lock);
+        while (!stopped && !failed && write_pos > min_consumed() &&
+               write_pos + total - min_consumed() > options.capacity) {
+            ++producers_waiting;
+            pthread_cond_wait(&not_full, &lock);
+            --producers_waiting;
+        }
+        if (stopped || failed) {
+            pthread_mutex_unlock(&lock);
+            return false;
+        }
+
+        uint64_t room = options.segment_size - write_pos % options.segment_size;
+        if (room < total) {
+            record_header* end = header_at(write_pos);
+            if (end == nullptr) {
+                pthread_mutex_unlock(&lock);
+                return false;
+            }
+            end->length = 0;
+            end->kind   = KIND_SEGMENT_END;
+            write_pos += room;
+        }
+
+        record_header* h = header_at(write_pos);
+        if (h == nullptr) {
+            pthread_mutex_unlock(&lock);
+            return false;
+        }
+        h->length = length;
+        h->kind   = KIND_RECORD;
+        memcpy(h + 1, data, length);
+        write_pos += total;
+
+        ++stats_now.appended;
+        stats_now.appended_bytes += length;
+        if (options.commit_bytes && !commit_requested &&
+            write_pos - durable_pos >= options.commit_bytes) {
+            commit_requested = true;
+            pthread_cond_signal(&commit_wanted);
+        }
+        pthread_mutex_unlock(&lock);
+        return true;
+    }
+
+    // Hand the next durable record of `group` to the caller. Blocks until
+    // one has been committed; returns false once the journal is shut down
+    // or has failed.
+    bool acquire(int group, journal_record* rec) {
+        pthread_mutex_lock(&lock);
+        group_state& g = groups[group];
+        while (!stopped && !failed) {
+            if (g.read_pos < durable_pos) {
+                record_header* h = header_at(g.read_pos);
+                if (h == nullptr) {
+                    fail(errno ? errno : ENOENT);   // segment file lost
+                    break;
+                }
+                if (h->kind == KIND_SEGMENT_END) {
+                    g.read_pos += options.segment_size - g.read_pos % options.segment_size;
+                    continue;
+                }
+                // a zero-filled or torn header is damage, not a record
+                uint64_t seg_end = g.read_pos - g.read_pos % options.segment_size + options.segment_size;
+                if (h->kind != KIND_RECORD || g.read_pos + record_size(h->length) > seg_end ||
+                    g.read_pos + record_size(h->length) > durable_pos) {
+                    fail(EBADMSG);
+                    break;
+                }
+                rec->data   = h + 1;
+                rec->length = h->length;
+                rec->offset = g.read_pos;
+                g.read_pos += record_size(h->length);
+                g.in_flight.push_back({rec->offset, false});
+                pthread_mutex_unlock(&lock);
+                return true;
+            }
+            pthread_cond_wait(&readable, &lock);
+        }
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    // Mark a record from acquire() processed. The group's offset moves
+    // once every older record of the group is released too.
+    void release(int group, const journal_record& rec) {
+        pthread_mutex_lock(&lock);
+        group_state& g = groups[group];
+        for (in_flight_record& r : g.in_flight) {
+            if (r.offset == rec.offset) {
+                r.released = true;
+                break;
+            }
+        }
+        uint64_t old_consumed = g.consumed_pos;
+        while (!g.in_flight.empty() && g.in_flight.front().released) g.in_flight.pop_front();
+        g.consumed_pos = g.in_flight.empty() ? g.read_pos : g.in_flight.front().offset;
+        if (g.consumed_pos != old_consumed && producers_waiting) pthread_cond_broadcast(&not_full);
+        pthread_mutex_unlock(&lock);
+    }
+
+    // Make everything appended and released so far durable now; does
+    // nothing once the journal has failed
+    void commit() {
+        pthread_mutex_lock(&commit_lock);
+
+        // what to sync, taken under the lock; the bytes below write_pos
+        // are complete and stay mapped until a later commit
+        pthread_mutex_lock(&lock);
+        uint64_t start = durable_pos, end = write_pos;
+        uint64_t offsets[MAX_GROUPS] = {};
+        bool moved = end != start;
+        for (int i = 0; i < num_groups; ++i) {
+            offsets[i] = groups[i].consumed_pos;
+            if (offsets[i] != groups[i].saved_pos) moved = true;
+        }
+        bool sync_dir = dir_dirty;
+        dir_dirty = false;
+        std::vector<std::pair<char*, size_t>> ranges;
+        for (uint64_t pos = start; pos < end; ) {
+            uint64_t base = pos - pos % options.segment_size;
+            uint64_t stop = base + options.segment_size < end ? base + options.segment_size : end;
+            char* seg_base = segments[base].base;
+            uint64_t from = (pos - base) & ~static_cast<uint64_t>(PAGE - 1);
+            ranges.push_back({seg_base + from, stop - base - from});
+            pos = stop;
+        }
+        bool give_up = failed;
+        pthread_mutex_unlock(&lock);
+
+        if (give_up || !moved) {
+            pthread_mutex_unlock(&commit_lock);
+            return;
+        }
+
+        // data first, then the directory entries of new segments, then
+        // the checkpoint that points at them; stop at the first failure
+        auto t0 = std::chrono::steady_clock::now();
+        int err = 0;
+        for (auto& r : ranges) {
+            if (msync(r.first, r.second, MS_SYNC) == -1) {
+                err = errno;
+                break;
+            }
+        }
+        if (err == 0 && sync_dir && sync_directory() == -1) err = errno;
+        if (err == 0 && write_checkpoint(end, offsets) == -1) err = errno;
+        double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        pthread_mutex_lock(&lock);
+        if (err != 0) {
+            fail(err);
+            pthread_mutex_unlock(&lock);
+            pthread_mutex_unlock(&commit_lock);
+            return;
+        }
+        durable_pos = end;
+        uint64_t retained = end;
+        for (int i = 0; i < num_groups; ++i) {
+            groups[i].saved_pos = offsets[i];
+            if (offsets[i] < retained) retained = offsets[i];
+        }
+        if (end != start) pthread_cond_broadcast(&readable);
+
+        // drop segments every group has moved past, durably
+        while (!segments.empty() &&
+               segments.begin()->first + options.segment_size <= retained) {
+            unmap_segment(segments.begin()->second);
+            unlink(segment_path(segments.begin()->first).c_str());
+            segments.erase(segments.begin());
+        }
+
+        ++stats_now.commits;
+        stats_now.synced_bytes += end - start;
+        stats_now.sync_seconds += took;
+        pthread_mutex_unlock(&lock);
+
+        pthread_mutex_unlock(&commit_lock);
+    }
+
+    // Wake every blocked append()/acquire() and make them fail from now on
+    void shutdown() {
+        pthread_mutex_lock(&lock);
+        stopped = true;
+        pthread_cond_broadcast(&readable);
+        pthread_cond_broadcast(&not_full);
+        pthread_mutex_unlock(&lock);
+    }
+
+    journal_stats stats() {
+        pthread_mutex_lock(&lock);
+        journal_stats s = stats_now;
+        pthread_mutex_unlock(&lock);
+        return s;
+    }
+
+    // End of the durable log, and a group's durable offset
+    uint64_t durable_end() {
+        pthread_mutex_lock(&lock);
+        uint64_t end = durable_pos;
+        pthread_mutex_unlock(&lock);
+        return end;
+    }
+
+    uint64_t group_offset(int group) {
+        pthread_mutex_lock(&lock);
+        uint64_t offset = groups[group].saved_pos;
+        pthread_mutex_unlock(&lock);
+        return offset;
+    }
+
+    int group_count() const { return num_groups; }
+
+    // errno of the sync or the damage that failed the journal, 0 if none
+    int error() {
+        pthread_mutex_lock(&lock);
+        int err = failed;
+        pthread_mutex_unlock(&lock);
+        return err;
+    }
+
+private:
+    static const uint64_t JOURNAL_MAGIC = 0x4c4e524a4f53502fULL;   // "/PSOJRNL"
+    static const uint64_t PAGE          = 4096;
+    static const size_t   META_SIZE     = 4096;
+
+    enum : uint32_t { KIND_RECORD = 1, KIND_SEGMENT_END = 2 };
+
+    struct record_header {
+        uint32_t length;   // payload bytes
+        uint32_t kind;
+    };
+
+    // One of the two alternating checkpoints in journal.meta
+    struct checkpoint {
+        uint64_t sequence;
+        uint64_t durable_end;
+        uint64_t group_offsets[MAX_GROUPS];
+        uint64_t checksum;   // over the fields above
+    };
+
+    struct journal_meta {
+        uint64_t   magic;
+        uint64_t   segment_size;
+        uint64_t   groups;
+        checkpoint slots[2];
+    };
+    static_assert(sizeof(journal_meta) <= META_SIZE, "metadata must fit in one page");
+
+    struct segment {
+        int   fd;
+        char* base;
+    };
+
+    struct in_flight_record {
+        uint64_t offset;
+        bool     released;
+    };
+
+    struct group_state {
+        uint64_t read_pos     = 0;   // next record to hand out
+        uint64_t consumed_pos = 0;   // everything below is released
+        uint64_t saved_pos    = 0;   // consumed_pos as of the last commit
+        std::deque<in_flight_record> in_flight;
+    };
+
+    journal(const std::string& dir, const journal_options& options)
+        : dir(dir), options(options) {
+        pthread_mutex_init(&lock, nullptr);
+        pthread_mutex_init(&commit_lock, nullptr);
+        pthread_cond_init(&readable, nullptr);
+        pthread_cond_init(&not_full, nullptr);
+        pthread_cond_init(&commit_wanted, nullptr);
+        if (this->options.commit_interval <= 0 && this->options.commit_bytes == 0)
+            this->options.commit_interval = 0.01;
+    }
+
+    static uint64_t record_size(uint32_t length) {
+        return (sizeof(record_header) + static_cast<uint64_t>(length) + 7) & ~static_cast<uint64_t>(7);
+    }
+
+    // FNV-1a over a checkpoint, minus its checksum field
+    static uint64_t checksum_of(const checkpoint& c) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(&c);
+        uint64_t h = 1469598103934665603ULL;
+        for (size_t i = 0; i < offsetof(checkpoint, checksum); ++i) {
+            h ^= p[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    // Segments are whole pages, so every mapping and msync() range is
+    // page aligned
+    static bool valid_segment_size(uint64_t size) {
+        return size >= PAGE && size % PAGE == 0;
+    }
+
+    static bool is_segment_name(const std::string& name) {
+        return name.size() == 24 && name.compare(20, 4, ".seg") == 0 &&
+               name.find_first_not_of("0123456789") == 20;
+    }
+
+    std::string segment_path(uint64_t base) const {
+        char name[32];
+        snprintf(name, sizeof(name), "/%020llu.seg", static_cast<unsigned long long>(base));
+        return dir + name;
+    }
+
+    uint64_t min_consumed() const {
+        uint64_t m = write_pos;
+        for (int i = 0; i < num_groups; ++i)
+            if (groups[i].consumed_pos < m) m = groups[i].consumed_pos;
+        return m;
+    }
+
+    // Header at a log position, mapping its segment on first use;
+    // called with the lock held. Only a segment starting at or past the
+    // durable end may be created: one holding durable records must
+    // already exist at full size. nullptr (errno set) if that fails.
+    record_header* header_at(uint64_t pos) {
+        uint64_t base = pos - pos % options.segment_size;
+        auto it = segments.find(base);
+        if (it == segments.end()) {
+            bool create = base >= durable_pos;
+            int fd = ::open(segment_path(base).c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+            if (fd == -1) return nullptr;
+            struct stat st;
+            if (fstat(fd, &st) == -1) {
+                ::close(fd);
+                return nullptr;
+            }
+            if (!create && st.st_size != static_cast<off_t>(options.segment_size)) {
+                ::close(fd);
+                errno = EBADMSG;
+                return nullptr;
+            }
+            if (create) {
+                if (st.st_size != static_cast<off_t>(options.segment_size) &&
+                    ftruncate(fd, options.segment_size) == -1) {
+                    ::close(fd);
+                    return nullptr;
+                }
+                dir_dirty = true;   // its entry may not be durable yet
+            }
+            void* mem = mmap(nullptr, options.segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (mem == MAP_FAILED) {
+                ::close(fd);
+                return nullptr;
+            }
+            it = segments.insert({base, segment{fd, static_cast<char*>(mem)}}).first;
+        }
+        return reinterpret_cast<record_header*>(it->second.base + (pos - base));
+    }
+
+    void unmap_segment(segment& s) {
+        munmap(s.base, options.segment_size);
+        ::close(s.fd);
+    }
+
+    // Map journal.meta, creating it for a new journal, then restore the
+    // newest valid checkpoint and drop segments it does not cover. A
+    // journal.meta that exists but cannot be trusted fails with EBADMSG
+    // and nothing is touched: starting over would drop every record.
+    bool recover() {
+        if (mkdir(dir.c_str(), 0755) == -1 && errno != EEXIST) return false;
+
+        std::string meta_path = dir + "/journal.meta";
+        meta_fd = ::open(meta_path.c_str(), O_RDWR);
+        if (meta_fd == -1 && errno == ENOENT) {
+            if (!valid_segment_size(options.segment_size)) {
+                errno = EINVAL;
+                return false;
+            }
+            if (!create_meta(meta_path)) return false;
+            meta_fd = ::open(meta_path.c_str(), O_RDWR);
+        }
+        if (meta_fd == -1) return false;
+        struct stat st;
+        if (fstat(meta_fd, &st) == -1) return false;
+        if (st.st_size < static_cast<off_t>(META_SIZE)) {
+            errno = EBADMSG;
+            return false;
+        }
+        void* mem = mmap(nullptr, META_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, meta_fd, 0);
+        if (mem == MAP_FAILED) return false;
+        meta = static_cast<journal_meta*>(mem);
+
+        // the checksums only cover the checkpoints, so check the geometry
+        // before any of it is used
+        const checkpoint* newest = nullptr;
+        if (meta->magic == JOURNAL_MAGIC && valid_segment_size(meta->segment_size) &&
+            meta->groups >= 1 && meta->groups <= MAX_GROUPS) {
+            for (const checkpoint& c : meta->slots) {
+                if (checksum_of(c) != c.checksum) continue;
+                if (newest == nullptr || c.sequence > newest->sequence) newest = &c;
+            }
+        }
+        if (newest == nullptr) {
+            errno = EBADMSG;
+            return false;
+        }
+
+        options.segment_size = meta->segment_size;
+        num_groups   = static_cast<int>(meta->groups);
+        sequence     = newest->sequence;
+        write_pos    = durable_pos = newest->durable_end;
+        groups.resize(num_groups);
+        uint64_t retained = write_pos;
+        for (int i = 0; i < num_groups; ++i) {
+            group_state& g = groups[i];
+            g.read_pos = g.consumed_pos = g.saved_pos = newest->group_offsets[i];
+            if (g.saved_pos < retained) retained = g.saved_pos;
+        }
+
+        // segments below every group or past the durable end are garbage
+        uint64_t last_base = write_pos - write_pos % options.segment_size;
+        if (DIR* d = opendir(dir.c_str())) {
+            while (dirent* e = readdir(d)) {
+                std::string name = e->d_name;
+                if (!is_segment_name(name)) continue;
+                uint64_t base = strtoull(name.c_str(), nullptr, 10);
+                if (base + options.segment_size <= retained || base > last_base)
+                    unlink((dir + "/" + name).c_str());
+            }
+            closedir(d);
+        }
+        return true;
+    }
+
+    // Write the metadata of an empty log to a temporary file and rename
+    // it into place, so journal.meta is either absent or complete
+    bool create_meta(const std::string& meta_path) {
+        journal_meta fresh;
+        memset(&fresh, 0, sizeof(fresh));
+        fresh.magic        = JOURNAL_MAGIC;
+        fresh.segment_size = options.segment_size;
+        fresh.groups       = options.groups < 1 ? 1 : (options.groups > MAX_GROUPS ? MAX_GROUPS : options.groups);
+        for (checkpoint& c : fresh.slots) c.checksum = checksum_of(c);
+        char page[META_SIZE] = {};
+        memcpy(page, &fresh, sizeof(fresh));
+
+        std::string tmp_path = meta_path + ".new";
+        int fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) return false;
+        bool ok = write(fd, page, META_SIZE) == static_cast<ssize_t>(META_SIZE) && fsync(fd) == 0;
+        int saved = errno;
+        ::close(fd);
+        errno = saved;
+        return ok && rename(tmp_path.c_str(), meta_path.c_str()) == 0 && sync_directory() == 0;
+    }
+
+    // Write the older slot and sync it; the newer one stays intact if
+    // this write is torn. -1 (errno set) if the sync fails.
+    int write_checkpoint(uint64_t end, const uint64_t* offsets) {
+        checkpoint& c = meta->slots[(sequence + 1) % 2];
+        c.sequence    = sequence + 1;
+        c.durable_end = end;
+        for (int i = 0; i < MAX_GROUPS; ++i) c.group_offsets[i] = i < num_groups ? offsets[i] : 0;
+        c.checksum = checksum_of(c);
+        if (msync(meta, META_SIZE, MS_SYNC) == -1) return -1;
+        ++sequence;
+        return 0;
+    }
+
+    // Make created files' directory entries durable; -1 (errno set) on failure
+    int sync_directory() {
+        int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd == -1) return -1;
+        int rc = fsync(fd);
+        int saved = errno;
+        ::close(fd);
+        errno = saved;
+        return rc;
+    }
+
+    // Enter the failed state and wake everyone; called with the lock held
+    void fail(int err) {
+        if (!failed) failed = err;
+        pthread_cond_broadcast(&readable);
+        pthread_cond_broadcast(&not_full);
+    }
+
+    // Background group commit: every commit_interval, or when an
+    // append() pushes the pending bytes past commit_bytes
+    void commit_loop() {
+        pthread_mutex_lock(&lock);
+        while (!committer_stop) {
+            if (!commit_requested) {
+                if (options.commit_interval > 0) {
+                    timespec deadline;
+                    clock_gettime(CLOCK_REALTIME, &deadline);
+                    long ns = static_cast<long>(options.commit_interval * 1e9);
+                    deadline.tv_sec  += ns / 1000000000L;
+                    deadline.tv_nsec += ns % 1000000000L;
+                    if (deadline.tv_nsec >= 1000000000L) {
+                        deadline.tv_sec  += 1;
+                        deadline.tv_nsec -= 1000000000L;
+                    }
+                    pthread_cond_timedwait(&commit_wanted, &lock, &deadline);
+                } else {
+                    pthread_cond_wait(&commit_wanted, &lock);
+                }
+            }
+            if (committer_stop) break;
+            commit_requested = false;
+            pthread_mutex_unlock(&lock);
+            commit();
+            pthread_mutex_lock(&lock);
+        }
+        pthread_mutex_unlock(&lock);
+    }
+
+    std::string     dir;
+    journal_options options;
+
+    int           meta_fd = -1;
+    journal_meta* meta    = nullptr;
+    uint64_t      sequence = 0;            // of the newest checkpoint
+    std::map<uint64_t, segment> segments;  // mapped, by start offset
+
+    // Synchronization
+    pthread_mutex_t lock;          // everything below
+    pthread_mutex_t commit_lock;   // one commit at a time
+    pthread_cond_t  readable;      // durable_pos moved
+    pthread_cond_t  not_full;      // a group's consumed_pos moved
+    pthread_cond_t  commit_wanted;
+
+    // Positions
+    uint64_t write_pos   = 0;
+    uint64_t durable_pos = 0;
+    int      num_groups  = 0;
+    std::vector<group_state> groups;
+
+    int  producers_waiting = 0;
+    bool commit_requested  = false;
+    bool committer_stop    = false;
+    bool stopped           = false;
+    bool dir_dirty         = false;   // a segment file was created since the last commit
+    int  failed            = 0;       // errno once the journal has failed
+    std::thread   committer;
+    journal_stats stats_now = {};
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,252 @@
+/**************************************************************
+ * pipeline.h
+ * Multi-stage pipeline built from BoundedBuffers.
+ *
+ *   Pipeline<Record> p(queue_capacity, batch_size);
+ *   p.add_stage("producer", 1, make_records)
+ *    .add_stage("parse",    2, parse)
+ *    .add_stage("enrich",   4, enrich)
+ *    .add_stage("sink",     1, store);
+ *   pipeline_report r = p.run(seconds);
+ *
+ * Work moves between stages as batches (std::vector<Record>). A batch
+ * is moved into the next stage's input queue, never copied, and empty
+ * batches go back to the source through a free list so their storage
+ * is reused.
+ *
+ * Every stage function has the signature bool(std::vector<Record>&):
+ *   - the first stage gets an empty batch to fill; returning false
+ *     ends the stream for that thread
+ *   - later stages get a batch to work on in place; returning false
+ *     drops the batch instead of passing it on
+ *
+ * Shutdown drains the pipeline: when the time is up the source threads
+ * stop, then each queue is closed only after every thread feeding it
+ * has exited, so nothing already produced is lost.
+ *
+ * The report gives, per stage: items and batches handled, throughput,
+ * utilization (time inside the stage function divided by threads ×
+ * elapsed) and the occupancy of its input queue, sampled over time.
+ * The stage with the highest utilization is reported as the
+ * bottleneck; a full queue in front of it and empty ones after it
+ * confirm the diagnosis.
+ **************************************************************/
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bounded_buffer.h"
+
+struct stage_report {
+    std::string name;
+    int    threads;
+    long   items;
+    long   batches;
+    double busy_seconds;   // summed over the stage's threads
+    double throughput;     // items / second
+    double utilization;    // busy_seconds / (threads * elapsed)
+    double avg_queue;      // input queue occupancy in batches; -1 for the source
+    size_t max_queue;
+};
+
+struct pipeline_report {
+    double elapsed;
+    std::vector<stage_report> stages;
+    int bottleneck;                               // index into stages
+    std::vector<double> sample_times;             // seconds since start
+    std::vector<std::vector<size_t>> occupancy;   // [sample][queue]
+};
+
+template <typename T, typename SyncPolicy = MutexSemaphorePolicy>
+class Pipeline {
+public:
+    typedef std::vector<T> batch_type;
+    typedef std::function<bool(batch_type&)> stage_fn;
+
+    explicit Pipeline(size_t queue_capacity = 16, size_t batch_size = 64)
+        : queue_capacity(queue_capacity), batch_size(batch_size) {}
+
+    Pipeline& add_stage(const std::string& name, int threads, stage_fn fn) {
+        stage s;
+        s.name    = name;
+        s.threads = threads > 0 ? threads : 1;
+        s.fn      = std::move(fn);
+        stages.push_back(std::move(s));
+        return *this;
+    }
+
+    size_t batch_capacity() const { return batch_size; }
+
+    // Run for `seconds`, sampling queue occupancy every `sample_interval`
+    // seconds, then drain and report. Needs at least two stages.
+    pipeline_report run(double seconds, double sample_interval = 0.01) {
+        typedef std::chrono::steady_clock clock;
+        const size_t n = stages.size();
+
+        std::vector<std::unique_ptr<queue_type>> queues;
+        for (size_t i = 0; i + 1 < n; ++i) queues.emplace_back(new queue_type(queue_capacity));
+        free_list_type free_batches(queue_capacity * n);
+
+        std::vector<stage_stats> stats(n);
+        std::atomic<bool> stopping(false);
+
+        auto t_start = clock::now();
+        std::vector<std::vector<std::thread>> threads(n);
+        for (size_t i = 0; i < n; ++i) {
+            queue_type* in  = i > 0     ? queues[i - 1].get() : nullptr;
+            queue_type* out = i + 1 < n ? queues[i].get()     : nullptr;
+            for (int t = 0; t < stages[i].threads; ++t) {
+                threads[i].emplace_back(&Pipeline::worker, this, std::ref(stages[i]), std::ref(stats[i]),
+                                        in, out, &free_batches, &stopping);
+            }
+        }
+
+        // sample occupancy until the time is up
+        pipeline_report report;
+        auto t_stop = t_start + std::chrono::duration_cast<clock::duration>(
+                                    std::chrono::duration<double>(seconds));
+        while (clock::now() < t_stop) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(sample_interval));
+            std::vector<size_t> sample;
+            for (auto& q : queues) sample.push_back(q->size_approx());
+            report.sample_times.push_back(std::chrono::duration<double>(clock::now() - t_start).count());
+            report.occupancy.push_back(sample);
+        }
+
+        // drain: stop the sources, then close each queue once its writers exit
+        stopping.store(true);
+        for (size_t i = 0; i < n; ++i) {
+            for (auto& th : threads[i]) th.join();
+            if (i < queues.size()) queues[i]->close();
+        }
+        report.elapsed = std::chrono::duration<double>(clock::now() - t_start).count();
+
+        // per-stage numbers
+        report.bottleneck = 0;
+        for (size_t i = 0; i < n; ++i) {
+            stage_report r;
+            r.name         = stages[i].name;
+            r.threads      = stages[i].threads;
+            r.items        = stats[i].items.load();
+            r.batches      = stats[i].batches.load();
+            r.busy_seconds = stats[i].busy_ns.load() / 1e9;
+            r.throughput   = report.elapsed > 0 ? r.items / report.elapsed : 0;
+            r.utilization  = report.elapsed > 0 ? r.busy_seconds / (r.threads * report.elapsed) : 0;
+            r.avg_queue    = i == 0 ? -1 : 0;
+            r.max_queue    = 0;
+            if (i > 0 && !report.occupancy.empty()) {
+                double sum = 0;
+                for (const auto& sample : report.occupancy) {
+                    sum += sample[i - 1];
+                    if (sample[i - 1] > r.max_queue) r.max_queue = sample[i - 1];
+                }
+                r.avg_queue = sum / report.occupancy.size();
+            }
+            report.stages.push_back(r);
+            if (r.utilization > report.stages[report.bottleneck].utilization)
+                report.bottleneck = static_cast<int>(i);
+        }
+        return report;
+    }
+
+private:
+    typedef BoundedBuffer<batch_type, dynamic_capacity, SyncPolicy> queue_type;
+    typedef BoundedBuffer<batch_type, dynamic_capacity, MpmcPolicy> free_list_type;
+
+    struct stage {
+        std::string name;
+        int         threads;
+        stage_fn    fn;
+    };
+
+    // Totals per stage; each thread adds its own counts once, on exit
+    struct alignas(64) stage_stats {
+        std::atomic<long> items{0};
+        std::atomic<long> batches{0};
+        std::atomic<long> busy_ns{0};
+    };
+
+    void worker(stage& st, stage_stats& stats, queue_type* in, queue_type* out,
+                free_list_type* free_batches, std::atomic<bool>* stopping) {
+        typedef std::chrono::steady_clock clock;
+        long items = 0, batches = 0;
+        clock::duration busy(0);
+
+        batch_type batch;
+        while (true) {
+            if (in == nullptr) {
+                // source: reuse a returned batch when one is available
+                if (stopping->load(std::memory_order_relaxed)) break;
+                if (!free_batches->try_pop(batch)) batch = batch_type();
+                batch.clear();
+                batch.reserve(batch_size);
+            } else if (!in->pop(batch)) {
+                break;  // input closed and drained
+            }
+
+            auto t0 = clock::now();
+            bool keep = st.fn(batch);
+            busy += clock::now() - t0;
+
+            // a source's last batch still goes downstream
+            bool forward    = in == nullptr || keep;
+            bool end_stream = in == nullptr && !keep;
+            items += static_cast<long>(batch.size());
+            ++batches;
+
+            if (out != nullptr && forward && !batch.empty()) {
+                if (!out->push(std::move(batch))) break;
+            } else {
+                batch.clear();
+                free_batches->try_push(std::move(batch));
+            }
+            if (end_stream) break;
+        }
+
+        stats.items   += items;
+        stats.batches += batches;
+        stats.busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count();
+    }
+
+    std::vector<stage> stages;
+    size_t queue_capacity;
+    size_t batch_size;
+};
+
+// Per-stage table plus the bottleneck verdict
+inline void print_pipeline_report(const pipeline_report& r, std::ostream& os) {
+    os << "Pipeline ran " << r.elapsed << " s" << std::endl;
+    os << "stage            threads        items    items/sec   util   avg_q   max_q" << std::endl;
+    for (size_t i = 0; i < r.stages.size(); ++i) {
+        const stage_report& s = r.stages[i];
+        char line[160];
+        snprintf(line, sizeof(line), "%-16s %7d %12ld %12.0f %5.1f%% %7s %7s%s",
+                 s.name.c_str(), s.threads, s.items, s.throughput, 100.0 * s.utilization,
+                 s.avg_queue < 0 ? "-" : std::to_string(s.avg_queue).substr(0, 5).c_str(),
+                 s.avg_queue < 0 ? "-" : std::to_string(s.max_queue).c_str(),
+                 static_cast<int>(i) == r.bottleneck ? "  <- bottleneck" : "");
+        os << line << std::endl;
+    }
+}
+
+// Occupancy time series: one row per sample, one column per queue
+inline void write_occupancy_csv(const pipeline_report& r, std::ostream& os) {
+    os << "time_s";
+    for (size_t i = 1; i < r.stages.size(); ++i) os << ",q_" << r.stages[i].name;
+    os << '\n';
+    for (size_t s = 0; s < r.occupancy.size(); ++s) {
+        os << r.sample_times[s];
+        for (size_t q : r.occupancy[s]) os << ',' << q;
+        os << '\n';
+    }
+}
+
+#endif // PIPELINE_H
@@ -0,0 +1,277 @@
+/**************************************************************
+ * placement.h
+ * CPU topology discovery and thread placement for the
+ * producer–consumer benchmark.
+ *
+ * Topology is read from /sys/devices/system/{cpu,node}. Placements:
+ *   none        - leave placement to the OS scheduler
+ *   compact     - fill one core / package before moving to the next
+ *   scatter     - spread threads round-robin across packages and cores
+ *   smt         - producer i and consumer i share one physical core
+ *                 (on SMT siblings when the core has them)
+ *   list:0,2,4  - explicit CPU list, ranges such as 0-3 allowed
+ *
+ * Threads are assigned in pair order p0, c0, p1, c1, ... followed by
+ * the leftover producers or consumers, cycling through the CPU
+ * sequence when there are more threads than CPUs.
+ *
+ * Pinning uses pthread_setaffinity_np and is only available on Linux;
+ * elsewhere every placement behaves like "none".
+ **************************************************************/
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+struct cpu_info {
+    int cpu;
+    int package;
+    int core;
+    int node;
+    int smt_index;  // position of this cpu among its core's siblings
+};
+
+enum placement_kind { PLACE_NONE, PLACE_COMPACT, PLACE_SCATTER, PLACE_SMT, PLACE_LIST };
+
+struct placement {
+    placement_kind   kind = PLACE_NONE;
+    std::vector<int> cpus;          // only for PLACE_LIST
+    std::string      name = "none";
+};
+
+// Parse a kernel cpu list such as "0-3,8,10-11"
+inline std::vector<int> parse_cpu_list(const std::string& text) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(',', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string part = text.substr(pos, end - pos);
+        size_t dash = part.find('-');
+        if (!part.empty() && part[0] != '\n') {
+            int lo = atoi(part.c_str());
+            int hi = dash == std::string::npos ? lo : atoi(part.c_str() + dash + 1);
+            for (int c = lo; c <= hi; ++c) cpus.push_back(c);
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+inline std::string read_sys_line(const std::string& path) {
+    std::ifstream f(path);
+    std::string line;
+    std::getline(f, line);
+    return line;
+}
+
+inline int read_sys_int(const std::string& path, int fallback) {
+    std::string line = read_sys_line(path);
+    return line.empty() ? fallback : atoi(line.c_str());
+}
+
+// Read every online cpu with its package, core, NUMA node and SMT slot
+inline std::vector<cpu_info> read_topology() {
+    const std::string cpu_root = "/sys/devices/system/cpu/";
+    std::vector<int> online = parse_cpu_list(read_sys_line(cpu_root + "online"));
+    if (online.empty()) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int c = 0; c < n; ++c) online.push_back(c);
+    }
+
+    // cpu -> node, from /sys/devices/system/node/node*/cpulist
+    std::map<int, int> cpu_node;
+    if (DIR* dir = opendir("/sys/devices/system/node")) {
+        while (dirent* e = readdir(dir)) {
+            if (strncmp(e->d_name, "node", 4) != 0 || !isdigit(e->d_name[4])) continue;
+            int node = atoi(e->d_name + 4);
+            std::string list = read_sys_line(std::string("/sys/devices/system/node/")
+                                             + e->d_name + "/cpulist");
+            for (int c : parse_cpu_list(list)) cpu_node[c] = node;
+        }
+        closedir(dir);
+    }
+
+    std::vector<cpu_info> topo;
+    for (int c : online) {
+        std::string base = cpu_root + "cpu" + std::to_string(c) + "/topology/";
+        cpu_info info;
+        info.cpu     = c;
+        info.package = read_sys_int(base + "physical_package_id", 0);
+        info.core    = read_sys_int(base + "core_id", c);
+        info.node    = cpu_node.count(c) ? cpu_node[c] : 0;
+
+        std::vector<int> siblings = parse_cpu_list(read_sys_line(base + "thread_siblings_list"));
+        auto it = std::find(siblings.begin(), siblings.end(), c);
+        info.smt_index = it == siblings.end() ? 0 : static_cast<int>(it - siblings.begin());
+        topo.push_back(info);
+    }
+    return topo;
+}
+
+inline int node_of_cpu(const std::vector<cpu_info>& topo, int cpu) {
+    for (const auto& info : topo)
+        if (info.cpu == cpu) return info.node;
+    return 0;
+}
+
+inline std::vector<int> cpus_of_node(const std::vector<cpu_info>& topo, int node) {
+    std::vector<int> cpus;
+    for (const auto& info : topo)
+        if (info.node == node) cpus.push_back(info.cpu);
+    return cpus;
+}
+
+// Parse "none", "compact", "scatter", "smt" or "list:<cpu list>"
+inline bool parse_placement(const std::string& spec, placement* out) {
+    out->name = spec;
+    out->cpus.clear();
+    if (spec == "none")         out->kind = PLACE_NONE;
+    else if (spec == "compact") out->kind = PLACE_COMPACT;
+    else if (spec == "scatter") out->kind = PLACE_SCATTER;
+    else if (spec == "smt")     out->kind = PLACE_SMT;
+    else if (spec.compare(0, 5, "list:") == 0) {
+        out->kind = PLACE_LIST;
+        out->cpus = parse_cpu_list(spec.substr(5));
+        if (out->cpus.empty()) return false;
+    }
+    else return false;
+    return true;
+}
+
+// Order in which threads receive cpus: p0, c0, p1, c1, ..., then leftovers.
+// Producers are numbered 0..P-1 and consumers P..P+C-1.
+inline std::vector<int> pair_order(int num_producers, int num_consumers) {
+    std::vector<int> order;
+    int pairs = std::min(num_producers, num_consumers);
+    for (int i = 0; i < pairs; ++i) {
+        order.push_back(i);
+        order.push_back(num_producers + i);
+    }
+    for (int i = pairs; i < num_producers; ++i) order.push_back(i);
+    for (int i = pairs; i < num_consumers; ++i) order.push_back(num_producers + i);
+    return order;
+}
+
+// Cpu sequence for a placement; threads take entries in pair order
+inline std::vector<int> placement_sequence(const placement& pl, const std::vector<cpu_info>& topo) {
+    std::vector<cpu_info> sorted = topo;
+    std::vector<int> seq;
+
+    switch (pl.kind) {
+    case PLACE_NONE:
+        break;
+
+    case PLACE_LIST:
+        seq = pl.cpus;
+        break;
+
+    case PLACE_COMPACT:
+        // neighbours in the sequence share a core, then a package
+        std::sort(sorted.begin(), sorted.end(), [](const cpu_info& a, const cpu_info& b) {
+            if (a.package != b.package) return a.package < b.package;
+            if (a.core != b.core)       return a.core < b.core;
+            return a.smt_index < b.smt_index;
+        });
+        for (const auto& info : sorted) seq.push_back(info.cpu);
+        break;
+
+    case PLACE_SCATTER:
+        // one cpu per package in turn, all first SMT threads before any sibling
+        std::sort(sorted.begin(), sorted.end(), [](const cpu_info& a, const cpu_info& b) {
+            if (a.smt_index != b.smt_index) return a.smt_index < b.smt_index;
+            if (a.core != b.core)           return a.core < b.core;
+            return a.package < b.package;
+        });
+        for (const auto& info : sorted) seq.push_back(info.cpu);
+        break;
+
+    case PLACE_SMT: {
+        // each pair gets the two siblings of one core; without SMT both
+        // threads of a pair share the same cpu
+        std::map<std::pair<int, int>, std::vector<int>> cores;
+        for (const auto& info : topo) cores[{info.package, info.core}].push_back(info.cpu);
+        for (auto& kv : cores) {
+            std::vector<int>& sib = kv.second;
+            seq.push_back(sib[0]);
+            seq.push_back(sib.size() > 1 ? sib[1] : sib[0]);
+        }
+        break;
+    }
+    }
+    return seq;
+}
+
+// Cpu for every thread (producers first, then consumers); -1 means unpinned
+inline std::vector<int> assign_cpus(const placement& pl, const std::vector<cpu_info>& topo,
+                                    int num_producers, int num_consumers) {
+    std::vector<int> cpus(num_producers + num_consumers, -1);
+    std::vector<int> seq = placement_sequence(pl, topo);
+    if (seq.empty()) return cpus;
+
+    std::vector<int> order = pair_order(num_producers, num_consumers);
+    for (size_t i = 0; i < order.size(); ++i)
+        cpus[order[i]] = seq[i % seq.size()];
+    return cpus;
+}
+
+// NUMA node holding most of the consumers, or -1 when they are unpinned
+inline int consumer_node(const std::vector<cpu_info>& topo, const std::vector<int>& cpus,
+                         int num_producers) {
+    std::map<int, int> votes;
+    for (size_t i = num_producers; i < cpus.size(); ++i)
+        if (cpus[i] >= 0) ++votes[node_of_cpu(topo, cpus[i])];
+    int best = -1, best_votes = 0;
+    for (auto& kv : votes)
+        if (kv.second > best_votes) { best = kv.first; best_votes = kv.second; }
+    return best;
+}
+
+// Pin a thread to a set of cpus; returns 0 on success
+inline int pin_thread(pthread_t thread, const std::vector<int>& cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus) CPU_SET(c, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set);
+#else
+    (void)thread;
+    (void)cpus;
+    return -1;
+#endif
+}
+
+// Run fn with the calling thread bound to one NUMA node so the pages it
+// touches first are allocated there, then restore the old affinity
+template <typename Fn>
+inline void run_on_node(const std::vector<cpu_info>& topo, int node, Fn fn) {
+#ifdef __linux__
+    std::vector<int> cpus = cpus_of_node(topo, node);
+    cpu_set_t saved;
+    if (node < 0 || cpus.empty()
+        || pthread_getaffinity_np(pthread_self(), sizeof(saved), &saved) != 0
+        || pin_thread(pthread_self(), cpus) != 0) {
+        fn();
+        return;
+    }
+    fn();
+    pthread_setaffinity_np(pthread_self(), sizeof(saved), &saved);
+#else
+    (void)topo;
+    (void)node;
+    fn();
+#endif
+}
+
+#endif // PLACEMENT_H
@@ -0,0 +1,167 @@
+/**************************************************************
+ * pollable_buffer.h
+ * BoundedBuffer with eventfd readiness, for epoll/poll event loops
+ * (Linux only).
+ *
+ *   PollableBuffer<T, Capacity, SyncPolicy>
+ *
+ *   readable_fd()   becomes readable when the buffer goes from empty to
+ *                   non-empty (or is closed)
+ *   writable_fd()   becomes readable when the buffer goes from full to
+ *                   non-full (or is closed)
+ *
+ * Neither side ever blocks inside the buffer. try_pop()/try_push()
+ * return false when the caller has to wait, and from then on the
+ * matching fd is guaranteed to fire once the situation changes. A loop
+ * waiting on many buffers looks like:
+ *
+ *   epoll_wait(...)                 // buffer's readable_fd is ready
+ *   buffer.drain(handle, 256);      // clear the fd, take up to 256 items
+ *
+ * The fds are only written on those transitions, not per item: the
+ * side that finds the buffer empty (full) arms a flag before it goes
+ * to sleep, and the other side only writes the eventfd when it sees
+ * that flag. A busy buffer costs no system calls at all.
+ *
+ * Arming is a Dekker-style handshake: the waiter stores the flag and
+ * then re-checks the buffer; the other side publishes its item and
+ * then checks the flag. Both sides put a sequentially consistent fence
+ * in between, so at least one of them sees the other and no wakeup is
+ * lost. A wakeup can be spurious (the item was already taken), so
+ * waiters must tolerate finding nothing.
+ **************************************************************/
+#ifndef POLLABLE_BUFFER_H
+#define POLLABLE_BUFFER_H
+
+#ifdef __linux__
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <utility>
+#include "bounded_buffer.h"
+
+template <typename T, size_t Capacity = dynamic_capacity,
+          typename SyncPolicy = MpmcPolicy>
+class PollableBuffer {
+public:
+    explicit PollableBuffer(size_t capacity = Capacity)
+        : buffer(capacity),
+          readable(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+          writable(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+    ~PollableBuffer() {
+        if (readable >= 0) ::close(readable);
+        if (writable >= 0) ::close(writable);
+    }
+
+    PollableBuffer(const PollableBuffer&) = delete;
+    PollableBuffer& operator=(const PollableBuffer&) = delete;
+
+    // False if eventfd() failed
+    bool valid() const { return readable >= 0 && writable >= 0; }
+
+    int readable_fd() const { return readable; }
+    int writable_fd() const { return writable; }
+
+    // False if full or closed; when full, writable_fd() fires once there
+    // is room again
+    bool try_push(T&& item) {
+        if (!buffer.try_push(std::move(item))) {
+            if (is_closed()) return false;
+            writer_waiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!buffer.try_push(std::move(item))) return false;
+            writer_waiting.store(false, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (reader_waiting.load(std::memory_order_relaxed) &&
+            reader_waiting.exchange(false, std::memory_order_relaxed))
+            signal(readable, readable_signals);
+        return true;
+    }
+
+    // False if empty; readable_fd() then fires once an item arrives or
+    // the buffer is closed
+    bool try_pop(T& out) {
+        if (!buffer.try_pop(out)) {
+            reader_waiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!buffer.try_pop(out)) return false;
+            reader_waiting.store(false, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (writer_waiting.load(std::memory_order_relaxed) &&
+            writer_waiting.exchange(false, std::memory_order_relaxed))
+            signal(writable, writable_signals);
+        return true;
+    }
+
+    // Call when readable_fd() is ready: clear it and hand up to
+    // max_items items to fn(T&). If items are left over, the fd is set
+    // again so the loop comes back to this buffer after serving others.
+    template <typename Fn>
+    size_t drain(Fn&& fn, size_t max_items) {
+        clear(readable);
+        size_t n = 0;
+        T item;
+        while (n < max_items && try_pop(item)) {
+            fn(item);
+            ++n;
+        }
+        if (n == max_items) signal(readable, readable_signals);
+        return n;
+    }
+
+    // Clear writable_fd() after it fired
+    void clear_writable() { clear(writable); }
+
+    // Make try_push() fail and wake every waiter on either fd;
+    // try_pop() still drains what is left
+    void close() {
+        closed.store(true, std::memory_order_release);
+        buffer.close();
+        signal(readable, readable_signals);
+        signal(writable, writable_signals);
+    }
+
+    bool is_closed() const { return closed.load(std::memory_order_acquire); }
+
+    size_t size_approx() { return buffer.size_approx(); }
+    size_t capacity() const { return buffer.capacity(); }
+
+    // eventfd writes so far, per fd
+    void counters(long* n_readable, long* n_writable) const {
+        *n_readable = readable_signals.load(std::memory_order_relaxed);
+        *n_writable = writable_signals.load(std::memory_order_relaxed);
+    }
+
+private:
+    static void clear(int fd) {
+        uint64_t value;
+        while (read(fd, &value, sizeof(value)) < 0 && errno == EINTR) {}
+    }
+
+    static void signal(int fd, std::atomic<long>& count) {
+        uint64_t one = 1;
+        while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    BoundedBuffer<T, Capacity, SyncPolicy> buffer;
+    int readable;
+    int writable;
+
+    // a new buffer is empty, so its reader starts out waiting
+    alignas(64) std::atomic<bool> reader_waiting{true};
+    alignas(64) std::atomic<bool> writer_waiting{false};
+    alignas(64) std::atomic<bool> closed{false};
+    std::atomic<long> readable_signals{0};
+    std::atomic<long> writable_signals{0};
+};
+
+#endif // __linux__
+
+#endif // POLLABLE_BUFFER_H
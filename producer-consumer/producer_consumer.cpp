@@ -2,208 +2,1264 @@
  * producer_consumer.cpp
  * Sean Baker 04/26/2025
  * sbake021@odu.edu
- * Bounded-buffer (size 5) producer–consumer solution using:
- *   - Pthreads (pthread_create) and optimizations including volatile and 
-     using memory pages to improve cache locality
- *   - POSIX semaphores (sem_init, sem_wait, sem_post)
- *   - A mutex lock for mutual exclusion
+ * Bounded-buffer (size 5) producer–consumer benchmark driver for
+ * BoundedBuffer (bounded_buffer.h), built from:
+ *   - Pthreads (pthread_create), one thread per producer / consumer
+ *   - A buffer object placed in POSIX shared memory (/OS) and touched
+ *     on creation to improve cache locality
+ *   - The buffer's synchronization policy: mutex + POSIX semaphores
+ *     (default), lock-free SPSC or lock-free MPMC
  *
  * Usage:
- *    g++ -o producer_consumer producer_consumer.cpp -pthread -lrt
+ *    g++ -std=c++20 -o producer_consumer producer_consumer.cpp -pthread -lrt
  *    ./producer_consumer <sleep_time> <num_producers> <num_consumers>
+ *    ./producer_consumer --bench <out.csv> [warmup_s] [window_s ...]
+ *    ./producer_consumer --pipeline <seconds> <threads,per,stage> [batch] [occupancy.csv]
+ *    ./producer_consumer --fanout <out.csv> [window_s] [consumers ...]
+ *    ./producer_consumer --epoll <seconds> <num_buffers> [capacity] [batch]
+ *    ./producer_consumer --durability <out.csv> [window_s] [commit_interval_s ...]
+ *    the first two forms accepts one or more --placement <spec> options
+ *    (none, compact, scatter, smt, list:<cpus>; see placement.h)
+ *    and --ring int|bytes|journal to pick the buffer under test
+ *    (journal: --journal-dir <dir> --commit-interval <s> --commit-bytes <n>)
+ *    and --sync mutex|spsc|mpmc for the int buffer's policy
+ *    and --shards K [--steal none|one|half] for the sharded int buffer
+ *    and --executor N to run the workers as coroutines on N threads
  *
  * Example:
  *    ./producer_consumer 10 1 1
+ *    ./producer_consumer 10 4 4 --placement compact
+ *    ./producer_consumer --bench results_bench.csv 0.05 0.001 0.01 0.1 1
+ *    ./producer_consumer --bench results_bench.csv --placement compact --placement scatter
+ *    ./producer_consumer 10 2 2 --ring bytes
+ *    ./producer_consumer 10 16 16 --shards 0 --steal half
+ *    ./producer_consumer 10 4 4 --sync mpmc
+ *    ./producer_consumer --pipeline 5 1,2,4,1 64 occupancy.csv
+ *    ./producer_consumer 10 4 1024 --executor 4
+ *    ./producer_consumer --fanout results_fanout.csv 1 16 256 4096
+ *    ./producer_consumer --epoll 5 64 256 64 --sync spsc
+ *    ./producer_consumer 10 2 2 --ring journal --commit-interval 0.005
+ *    ./producer_consumer --durability results_durability.csv 1 0.0001 0.001 0.01 0.1
  *
  * Explanation:
  *   - Main creates <num_producers> producer threads
  *   - Main creates <num_consumers> consumer threads
- *   - Main sleeps for <sleep_time> seconds, then the program exits
+ *   - All threads wait at a start gate so creation cost is not timed
+ *   - Main sleeps for <sleep_time> seconds, then signals the workers
+ *     to stop, closes the buffer and joins them before reporting
+ *
+ * Benchmark mode runs the whole 12-case producer × consumer matrix for
+ * every measurement window inside this one process. Each run gets a
+ * warmup period whose items are not counted, then a measured window,
+ * and one CSV row is written per run. With several placements the
+ * matrix is repeated once per placement. --sync spsc only runs the
+ * 1 producer / 1 consumer case.
+ *
+ * --ring bytes swaps the 5-slot int buffer for the zero-copy record ring
+ * in byte_ring.h: producers claim 16 B - 64 KB records, write them in
+ * place and commit them; consumers read them in place and release them.
+ *
+ * --shards K splits the int buffer into K sub-rings (sharded_buffer.h,
+ * K = 0 picks max(producers, consumers), or min() with --steal none).
+ * Producer i fills shard i % K; consumer j drains shard j % K and
+ * steals from the others as the --steal policy allows. --steal none
+ * skips runs with more shards than min(producers, consumers).
+ *
+ * Pipeline mode chains four stages, producer -> parse -> enrich -> sink,
+ * through BoundedBuffers (pipeline.h) with the given thread count per
+ * stage, and reports per-stage throughput, utilization, input-queue
+ * occupancy and the bottleneck stage. --sync picks the queues' policy.
+ *
+ * --executor N turns every producer and consumer into a C++20 coroutine
+ * awaiting an AsyncBoundedBuffer (async_buffer.h); all of them share N
+ * executor threads instead of getting a pthread each. Fanout mode runs
+ * 4 producers against growing consumer counts, once with a thread per
+ * consumer and once with coroutines, and writes both to CSV.
+ *
+ * Epoll mode (Linux) gives each of <num_buffers> PollableBuffers
+ * (pollable_buffer.h) its own producer thread, and drains all of them
+ * from one consumer thread running a single epoll loop that also
+ * serves a periodic timer and the deadline timer. It reports how many
+ * items each wakeup and each eventfd write carried.
+ *
+ * --ring journal moves the ints through the durable journal in
+ * journal.h: memory-mapped segment files with group commit. A single
+ * run keeps the journal directory, so the next run resumes from the
+ * committed consumer offset. Durability mode runs 4 producers / 4
+ * consumers on a fresh journal for each commit interval and writes
+ * throughput, commits and msync time to CSV.
+ *
+ * When threads are pinned, the buffer is first touched from the NUMA
+ * node that holds most of the consumers so its pages are allocated
+ * there.
  *
  **************************************************************/
 #include <iostream>
+#include <fstream>
 #include <pthread.h>
-#include <semaphore.h>
 #include <unistd.h>
 #include <cstdlib>
-#include <ctime>
 #include <vector>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <cstring>
-#include <thread>    
-#include <chrono>    
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <string>
+#include <map>
+#include <optional>
+#include <algorithm>
+#include <new>
+#include "placement.h"
+#include "byte_ring.h"
+#include "sharded_buffer.h"
+#include "bounded_buffer.h"
+#include "pipeline.h"
+#include "async_buffer.h"
+#include "pollable_buffer.h"
+#include "journal.h"
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <poll.h>
+#endif
 
 using namespace std;
 
 typedef int buffer_item;
 #define BUFFER_SIZE 5
+#define SHM_NAME "/OS"
+
+// Record ring (--ring bytes)
+#define RECORD_RING_NAME "/OS_records"
+#define RECORD_RING_SIZE (4 << 20)
+#define RECORD_MIN 16
+#define RECORD_MAX (64 << 10)
 
-// Shared memory
-int shm_fd;
-void* ptr;
+// Durable journal (--ring journal)
+#define JOURNAL_DIR "pc_journal"
 
-// Synchronization
-sem_t sem_empty;
-sem_t full;
-pthread_mutex_t mutex_lock;
+enum ring_kind { RING_INT, RING_BYTES, RING_JOURNAL };
 
-// Counters
-int total_produced = 0;
-int total_consumed = 0;
+// Parse "int", "bytes" or "journal"
+bool parse_ring_kind(const string& text, ring_kind* out) {
+    if (text == "int")          *out = RING_INT;
+    else if (text == "bytes")   *out = RING_BYTES;
+    else if (text == "journal") *out = RING_JOURNAL;
+    else return false;
+    return true;
+}
 
-// Thread functionsoid* producer(void*);
-void* consumer(void*);
+const char* ring_kind_name(ring_kind kind) {
+    switch (kind) {
+    case RING_INT:     return "int";
+    case RING_BYTES:   return "bytes";
+    case RING_JOURNAL: return "journal";
+    }
+    return "?";
+}
 
+enum sync_kind { SYNC_MUTEX, SYNC_SPSC, SYNC_MPMC };
 
-// Initialize shared memory buffer and touch memory to improve cache locality
-void initialize_shared_memory() {
-    shm_unlink("/OS");
-    shm_fd = shm_open("/OS", O_CREAT | O_RDWR, 0666);
-    if (shm_fd == -1) exit(1);
+// Parse "mutex", "spsc" or "mpmc"
+bool parse_sync_kind(const string& text, sync_kind* out) {
+    if (text == "mutex")     *out = SYNC_MUTEX;
+    else if (text == "spsc") *out = SYNC_SPSC;
+    else if (text == "mpmc") *out = SYNC_MPMC;
+    else return false;
+    return true;
+}
 
-    size_t size = BUFFER_SIZE * sizeof(buffer_item) + 2 * sizeof(int);
-    if (ftruncate(shm_fd, size) == -1) exit(1);
+const char* sync_kind_name(sync_kind kind) {
+    switch (kind) {
+    case SYNC_MUTEX: return "mutex";
+    case SYNC_SPSC:  return "spsc";
+    case SYNC_MPMC:  return "mpmc";
+    }
+    return "?";
+}
 
-    ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (ptr == MAP_FAILED) exit(1);
+// Everything the command line selects
+struct bench_config {
+    vector<cpu_info>  topology;       // read once from /sys
+    vector<placement> placements;
+    ring_kind    ring         = RING_INT;
+    sync_kind    sync         = SYNC_MUTEX;
+    int          shard_option = -1;   // -1 keeps the single buffer
+    steal_policy steal        = STEAL_ONE;
+    int          executor_threads = 0;  // 0 = one pthread per worker
+    string          journal_dir  = JOURNAL_DIR;
+    journal_options journal;
+    bool            journal_keep = false;   // resume from the last run
+};
 
-    buffer_item* buffer = static_cast<buffer_item*>(ptr);
-    for (int i = 0; i < BUFFER_SIZE; ++i) buffer[i] = -1;
+// Start gate: workers block here until main releases them all at once
+class start_gate {
+public:
+    start_gate() {
+        pthread_mutex_init(&lock, nullptr);
+        pthread_cond_init(&cond, nullptr);
+    }
+    ~start_gate() {
+        pthread_cond_destroy(&cond);
+        pthread_mutex_destroy(&lock);
+    }
 
-    int* in  = reinterpret_cast<int*>(buffer + BUFFER_SIZE);
-    int* out = in + 1;
-    *in  = 0;
-    *out = 0;
+    void wait() {
+        pthread_mutex_lock(&lock);
+        while (!is_open) pthread_cond_wait(&cond, &lock);
+        pthread_mutex_unlock(&lock);
+    }
 
-    // Touch all memory pages to improve cache locality
-    for (int i = 0; i < BUFFER_SIZE; ++i) {
-        volatile buffer_item tmp = buffer[i];  // Read from the buffer to ensure it's loaded into cache
+    void open() {
+        pthread_mutex_lock(&lock);
+        is_open = true;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
     }
 
-    // Touch the in and out pointers
-    volatile int tmp_in = *in;
-    volatile int tmp_out = *out;
-}
+private:
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    bool is_open = false;
+};
+
+// A per-thread counter on its own cache line; only its thread writes it
+struct alignas(64) thread_counter {
+    atomic<long> value{0};
 
+    void add(long n) { value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed); }
+};
 
-// Cleanup shared memory
-void cleanup_shared_memory() {
-    shm_unlink("/OS");
+// State shared by the threads of one run
+struct run_state {
+    run_state(int num_producers, int num_consumers)
+        : produced(num_producers), consumed(num_consumers), consumed_bytes(num_consumers) {}
+
+    atomic<bool> stop{false};
+    start_gate   gate;
+    vector<thread_counter> produced;        // one per producer
+    vector<thread_counter> consumed;        // one per consumer
+    vector<thread_counter> consumed_bytes;  // one per consumer
+};
+
+// Per-thread arguments
+struct worker_args {
+    unsigned   seed;
+    int        index;   // producer or consumer number
+    run_state* state;
+    void*      buffer;
+};
+
+// Result of one timed run
+struct run_result {
+    bool   skipped;     // configuration not supported by the buffer
+    double elapsed;
+    long   produced;
+    long   consumed;
+    long   consumed_bytes;
+    journal_stats journal = {};   // --ring journal only: commits during the window
+};
+
+
+// Sum the per-thread counters
+void snapshot_counters(run_state& state, long* produced, long* consumed, long* consumed_bytes) {
+    *produced = *consumed = *consumed_bytes = 0;
+    for (auto& c : state.produced)       *produced       += c.value.load(memory_order_relaxed);
+    for (auto& c : state.consumed)       *consumed       += c.value.load(memory_order_relaxed);
+    for (auto& c : state.consumed_bytes) *consumed_bytes += c.value.load(memory_order_relaxed);
 }
 
-// Insert item into buffer and count
-int insert_item(buffer_item item) {
-    sem_wait(&sem_empty);
-    pthread_mutex_lock(&mutex_lock);
+// Commit stats so far; only the journal keeps any
+journal_stats journal_stats_of(journal* log) { return log->stats(); }
 
-    auto* buffer = static_cast<buffer_item*>(ptr);
-    int* in = reinterpret_cast<int*>(buffer + BUFFER_SIZE);
-    *in = (*in + 1) % BUFFER_SIZE;
-    buffer[*in] = item;
-    ++total_produced;
+template <typename Buffer>
+journal_stats journal_stats_of(Buffer*) { return {}; }
 
-    pthread_mutex_unlock(&mutex_lock);
-    sem_post(&full);
-    return 0;
+// What happened between two journal_stats snapshots
+journal_stats journal_stats_between(const journal_stats& from, const journal_stats& to) {
+    journal_stats d;
+    d.appended       = to.appended - from.appended;
+    d.appended_bytes = to.appended_bytes - from.appended_bytes;
+    d.commits        = to.commits - from.commits;
+    d.synced_bytes   = to.synced_bytes - from.synced_bytes;
+    d.sync_seconds   = to.sync_seconds - from.sync_seconds;
+    return d;
 }
 
-// Remove item from buffer and count
-int remove_item(buffer_item* item) {
-    // Wait until there is at least one item in the buffer
-    sem_wait(&full);  
 
-    pthread_mutex_lock(&mutex_lock);
+// A BoundedBuffer of ints living in the /OS shared-memory segment
+template <typename Buffer>
+struct int_workload {
+    typedef Buffer buffer_type;
 
-    auto* buffer = static_cast<buffer_item*>(ptr);
-    int* out = reinterpret_cast<int*>(buffer + BUFFER_SIZE) + 1;
+    static Buffer* create(const bench_config&, int, int) {
+        shm_unlink(SHM_NAME);
+        int fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
+        if (fd == -1) exit(1);
+        if (ftruncate(fd, sizeof(Buffer)) == -1) exit(1);
 
-    // If the item at 'out' is valid (not -1), consume it
-    if (buffer[*out] != -1) {
-        *item = buffer[*out];  // Remove the item
-        ++total_consumed;       // Increment the total consumed count
-        *out = (*out + 1) % BUFFER_SIZE;  // Update the circular buffer index
+        void* mem = mmap(nullptr, sizeof(Buffer), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mem == MAP_FAILED) exit(1);
+
+        // constructing in place touches every page of the buffer
+        return new (mem) Buffer(BUFFER_SIZE);
     }
 
-    pthread_mutex_unlock(&mutex_lock);
-    sem_post(&sem_empty);  // Signal that there's an empty slot available
-    return 0;
-}
+    static void destroy(Buffer* buffer) {
+        buffer->~Buffer();
+        munmap(buffer, sizeof(Buffer));
+        shm_unlink(SHM_NAME);
+    }
 
+    static void stop(Buffer* buffer) { buffer->close(); }
+    static void* producer(void* param) {
+        auto* args   = static_cast<worker_args*>(param);
+        auto* buffer = static_cast<Buffer*>(args->buffer);
+        thread_counter& produced = args->state->produced[args->index];
+        minstd_rand rng(args->seed);
+        uniform_int_distribution<buffer_item> dist(1, 5);
 
+        args->state->gate.wait();
+        while (!args->state->stop.load(memory_order_relaxed)) {
+            buffer_item item = dist(rng);
+            if (!buffer->push(std::move(item))) break;
+            produced.add(1);
+        }
+        return nullptr;
+    }
+
+    static void* consumer(void* param) {
+        auto* args   = static_cast<worker_args*>(param);
+        auto* buffer = static_cast<Buffer*>(args->buffer);
+        thread_counter& consumed = args->state->consumed[args->index];
+        thread_counter& bytes    = args->state->consumed_bytes[args->index];
 
-// Producer thread: produce forever
-void* producer(void*) {
-    while (true) {
-        buffer_item item = (rand() % 5) + 1;
-        insert_item(item);
+        args->state->gate.wait();
+        while (!args->state->stop.load(memory_order_relaxed)) {
+            buffer_item item;
+            if (!buffer->pop(item)) break;
+            consumed.add(1);
+            bytes.add(sizeof(buffer_item));
+        }
+        return nullptr;
     }
-    return nullptr;
+};
+
+// Number of shards used for a run (1 = the single buffer). Without
+// stealing, a shard lacking a producer or a consumer never moves an
+// item, so K = 0 then picks min(producers, consumers).
+int shard_count(const bench_config& cfg, int num_producers, int num_consumers) {
+    if (cfg.shard_option < 0) return 1;
+    if (cfg.shard_option > 0) return cfg.shard_option;
+    return cfg.steal == STEAL_NONE ? min(num_producers, num_consumers)
+                                   : max(num_producers, num_consumers);
 }
 
-// Consumer thread: consume forever
-void* consumer(void*) {
-    while (true) {
-        buffer_item item;
-        remove_item(&item);
+// Why a configuration cannot run with this many threads; nullptr if it can
+const char* unsupported_reason(const bench_config& cfg, int num_producers, int num_consumers) {
+    if (cfg.executor_threads > 0 || cfg.ring != RING_INT) return nullptr;
+    if (cfg.shard_option >= 0) {
+        if (cfg.steal == STEAL_NONE &&
+            shard_count(cfg, num_producers, num_consumers) > min(num_producers, num_consumers))
+            return "--steal none needs at most min(producers, consumers) shards";
+        return nullptr;
     }
+    if (cfg.sync == SYNC_SPSC && (num_producers != 1 || num_consumers != 1))
+        return "spsc needs exactly 1 producer and 1 consumer";
     return nullptr;
 }
 
-int main(int argc, char* argv[]) {
-    if (argc != 4) return 1;
+// K sub-rings with work stealing (--shards)
+struct sharded_workload {
+    typedef sharded_buffer buffer_type;
 
-    // parse args (now supports fractional seconds)
-    double sleep_time    = atof(argv[1]);
-    int    num_producers = atoi(argv[2]);
-    int    num_consumers = atoi(argv[3]);
+    static sharded_buffer* create(const bench_config& cfg, int num_producers, int num_consumers) {
+        return new sharded_buffer(shard_count(cfg, num_producers, num_consumers),
+                                  BUFFER_SIZE, cfg.steal);
+    }
 
-    cout << "Parameters -> sleep_time: " << sleep_time
-         << ", producers: "  << num_producers
-         << ", consumers: "  << num_consumers << endl;
+    static void destroy(sharded_buffer* shards) { delete shards; }
+
+    static void stop(sharded_buffer* shards) { shards->shutdown(); }
+    // always fills the same shard
+    static void* producer(void* param) {
+        auto* args   = static_cast<worker_args*>(param);
+        auto* shards = static_cast<sharded_buffer*>(args->buffer);
+        thread_counter& produced = args->state->produced[args->index];
+        minstd_rand rng(args->seed);
+        uniform_int_distribution<buffer_item> dist(1, 5);
+        int home = args->index % shards->num_shards();
+
+        args->state->gate.wait();
+        while (!args->state->stop.load(memory_order_relaxed)) {
+            if (!shards->insert(home, dist(rng))) break;
+            produced.add(1);
+        }
+        return nullptr;
+    }
+
+    // drains its home shard, steals per the policy
+    static void* consumer(void* param) {
+        auto* args   = static_cast<worker_args*>(param);
+        auto* shards = static_cast<sharded_buffer*>(args->buffer);
+        thread_counter& consumed = args->state->consumed[args->index];
+        thread_counter& bytes    = args->state->consumed_bytes[args->index];
+        int home = args->index % shards->num_shards();
+        steal_cache cache;
+
+        args->state->gate.wait();
+        while (!args->state->stop.load(memory_order_relaxed)) {
+            buffer_item item;
+            if (!shards->remove(home, &cache, &item)) break;
+            consumed.add(1);
+            bytes.add(sizeof(buffer_item));
+        }
+        return nullptr;
+    }
+};
+
+// Zero-copy variable-length records (--ring bytes)
+struct record_workload {
+    typedef byte_ring buffer_type;
+
+    static byte_ring* create(const bench_config&, int, int) {
+        byte_ring* records = byte_ring::create(RECORD_RING_NAME, RECORD_RING_SIZE);
+        if (records == nullptr) exit(1);
+        return records;
+    }
+
+    static void destroy(byte_ring* records) { byte_ring::destroy(records, RECORD_RING_NAME); }
+
+    static void stop(byte_ring* records) { records->shutdown(); }
+    // claim a random-sized record, build it in place, commit
+    static void* producer(void* param) {
+        auto* args    = static_cast<worker_args*>(param);
+        auto* records = static_cast<byte_ring*>(args->buffer);
+        thread_counter& produced = args->state->produced[args->index];
+        minstd_rand rng(args->seed);
+        uniform_int_distribution<uint32_t> size_dist(RECORD_MIN, RECORD_MAX);
+
+        args->state->gate.wait();
+        while (!args->state->stop.load(memory_order_relaxed)) {
+            uint32_t length = size_dist(rng);
+            auto* rec = static_cast<uint32_t*>(records->claim(length));
+            if (rec == nullptr) break;
+
+            rec[0] = length;
+            memset(rec + 1, static_cast<int>(length & 0xff), length - sizeof(uint32_t));
+            records->commit(rec);
+            produced.add(1);
+        }
+        return nullptr;
+    }
+
+    // read each record where it lies, then release it
+    static void* consumer(void* param) {
+        auto* args    = static_cast<worker_args*>(param);
+        auto* records = static_cast<byte_ring*>(args->buffer);
+        thread_counter& consumed = args->state->consumed[args->index];
+        thread_counter& bytes    = args->state->consumed_bytes[args->index];
+        record_view view;
+
+        args->state->gate.wait();
+        while (!args->state->stop.load(memory_order_relaxed)) {
+            if (!records->acquire(&view)) break;
+
+            const auto* rec = static_cast<const uint32_t*>(view.data);
+            if (rec[0] != view.length)
+                cerr << "corrupt record: header " << view.length << ", payload " << rec[0] << endl;
+            consumed.add(1);
+            bytes.add(view.length);
+            records->release(view);
+        }
+        return nullptr;
+    }
+};
+
+// ints through the durable journal (--ring journal); consumers form
+// one group
+struct journal_workload {
+    typedef journal buffer_type;
+
+    static journal* create(const bench_config& cfg, int, int) {
+        if (!cfg.journal_keep) journal::remove(cfg.journal_dir);
+        journal* log = journal::open(cfg.journal_dir, cfg.journal);
+        if (log == nullptr) {
+            perror(cfg.journal_dir.c_str());
+            exit(1);
+        }
+        if (cfg.journal_keep && log->durable_end() > 0) {
+            cout << "Recovered journal " << cfg.journal_dir << ": log ends at "
+                 << log->durable_end() << ", consumers resume at " << log->group_offset(0)
+                 << " (" << log->durable_end() - log->group_offset(0) << " bytes to deliver)" << endl;
+        }
+        return log;
+    }
 
-    srand(static_cast<unsigned>(time(nullptr)));
+    static void destroy(journal* log) {
+        if (int err = log->error()) cerr << "journal failed: " << strerror(err) << endl;
+        delete log;   // final commit
+    }
+
+    static void stop(journal* log) { log->shutdown(); }
+    static void* producer(void* param) {
+        auto* args = static_cast<worker_args*>(param);
+        auto* log  = static_cast<journal*>(args->buffer);
+        thread_counter& produced = args->state->produced[args->index];
+        minstd_rand rng(args->seed);
+        uniform_int_distribution<buffer_item> dist(1, 5);
+
+        args->state->gate.wait();
+        while (!args->state->stop.load(memory_order_relaxed)) {
+            buffer_item item = dist(rng);
+            if (!log->append(&item, sizeof(item))) break;
+            produced.add(1);
+        }
+        return nullptr;
+    }
+
+    // read each committed record in place, then release it
+    static void* consumer(void* param) {
+        auto* args = static_cast<worker_args*>(param);
+        auto* log  = static_cast<journal*>(args->buffer);
+        thread_counter& consumed = args->state->consumed[args->index];
+        thread_counter& bytes    = args->state->consumed_bytes[args->index];
+        journal_record rec;
+
+        args->state->gate.wait();
+        while (!args->state->stop.load(memory_order_relaxed)) {
+            if (!log->acquire(0, &rec)) break;
+            consumed.add(1);
+            bytes.add(rec.length);
+            log->release(0, rec);
+        }
+        return nullptr;
+    }
+};
 
-    sem_init(&sem_empty, 0, BUFFER_SIZE);
-    sem_init(&full,      0, 0);
-    pthread_mutex_init(&mutex_lock, nullptr);
 
-    initialize_shared_memory();
+// Run one producer/consumer configuration: start every thread behind the
+// gate, let it warm up, count only the items moved during the window, then
+// stop and join all workers.
+template <typename Workload>
+run_result run_with(const bench_config& cfg, const placement& pl,
+                    int num_producers, int num_consumers,
+                    double warmup_time, double window_time) {
+    typedef typename Workload::buffer_type buffer_type;
+    vector<int> cpus = assign_cpus(pl, cfg.topology, num_producers, num_consumers);
 
-    // start timing
-    auto t_start = chrono::high_resolution_clock::now();
+    // place the buffer on the consumers' NUMA node (first-touch allocation)
+    buffer_type* buffer = nullptr;
+    run_on_node(cfg.topology, consumer_node(cfg.topology, cpus, num_producers), [&] {
+        buffer = Workload::create(cfg, num_producers, num_consumers);
+    });
+
+    run_state state(num_producers, num_consumers);
+
+    // per-thread seeds so producers never share rand()'s global state
+    random_device rd;
+    vector<worker_args> prod_args(num_producers);
+    for (int i = 0; i < num_producers; ++i)
+        prod_args[i] = {rd() ^ static_cast<unsigned>(i), i, &state, buffer};
+    vector<worker_args> cons_args(num_consumers);
+    for (int i = 0; i < num_consumers; ++i)
+        cons_args[i] = {0, i, &state, buffer};
 
     // launch producers
     vector<pthread_t> prod_threads(num_producers);
     for (int i = 0; i < num_producers; ++i)
-        pthread_create(&prod_threads[i], nullptr, producer, nullptr);
+        pthread_create(&prod_threads[i], nullptr, Workload::producer, &prod_args[i]);
 
     // launch consumers
     vector<pthread_t> cons_threads(num_consumers);
     for (int i = 0; i < num_consumers; ++i)
-        pthread_create(&cons_threads[i], nullptr, consumer, nullptr);
+        pthread_create(&cons_threads[i], nullptr, Workload::consumer, &cons_args[i]);
+
+    // pin before the gate opens so no work happens on the wrong cpu
+    for (int i = 0; i < num_producers + num_consumers; ++i) {
+        if (cpus[i] < 0) continue;
+        pthread_t t = i < num_producers ? prod_threads[i] : cons_threads[i - num_producers];
+        if (pin_thread(t, {cpus[i]}) != 0)
+            cerr << "warning: could not pin thread " << i << " to cpu " << cpus[i] << endl;
+    }
+
+    state.gate.open();
+
+    // warmup: let the threads reach steady state, then take a baseline
+    if (warmup_time > 0)
+        this_thread::sleep_for(chrono::duration<double>(warmup_time));
+
+    // the journal's stats take its lock, so read them outside the timed
+    // counter snapshots
+    journal_stats base_journal = journal_stats_of(buffer);
+    long base_produced, base_consumed, base_bytes;
+    snapshot_counters(state, &base_produced, &base_consumed, &base_bytes);
+    auto t_start = chrono::steady_clock::now();
 
     // fractional sleep: e.g. 2.5 seconds
-    this_thread::sleep_for(chrono::duration<double>(sleep_time));
+    this_thread::sleep_for(chrono::duration<double>(window_time));
 
-    // end timing
-    auto t_end   = chrono::high_resolution_clock::now();
-    double elapsed = chrono::duration<double>(t_end - t_start).count();
+    long end_produced, end_consumed, end_bytes;
+    snapshot_counters(state, &end_produced, &end_consumed, &end_bytes);
+    auto t_end = chrono::steady_clock::now();
+    journal_stats end_journal = journal_stats_of(buffer);
+
+    // stop: raise the flag, close the buffer so nobody stays blocked,
+    // and join everyone
+    state.stop.store(true);
+    Workload::stop(buffer);
+    for (auto& t : prod_threads) pthread_join(t, nullptr);
+    for (auto& t : cons_threads) pthread_join(t, nullptr);
+
+    // cleanup
+    Workload::destroy(buffer);
+
+    run_result r;
+    r.skipped  = false;
+    r.elapsed  = chrono::duration<double>(t_end - t_start).count();
+    r.produced = end_produced - base_produced;
+    r.consumed = end_consumed - base_consumed;
+    r.consumed_bytes = end_bytes - base_bytes;
+    r.journal  = journal_stats_between(base_journal, end_journal);
+    return r;
+}
+
+// Coroutine versions of the int workload's producer and consumer loops
+async_task async_producer(AsyncBoundedBuffer<buffer_item>& buffer, run_state& state,
+                          int index, unsigned seed) {
+    thread_counter& produced = state.produced[index];
+    minstd_rand rng(seed);
+    uniform_int_distribution<buffer_item> dist(1, 5);
+
+    while (!state.stop.load(memory_order_relaxed)) {
+        if (!co_await buffer.push(dist(rng))) break;
+        produced.add(1);
+    }
+}
+
+async_task async_consumer(AsyncBoundedBuffer<buffer_item>& buffer, run_state& state, int index) {
+    thread_counter& consumed = state.consumed[index];
+    thread_counter& bytes    = state.consumed_bytes[index];
+
+    while (!state.stop.load(memory_order_relaxed)) {
+        optional<buffer_item> item = co_await buffer.pop();
+        if (!item) break;
+        consumed.add(1);
+        bytes.add(sizeof(buffer_item));
+    }
+}
+
+// Same measurement as run_with, with every worker a coroutine on the
+// executor (--executor). The executor threads are not pinned.
+run_result run_async(const bench_config& cfg, int num_producers, int num_consumers,
+                     double warmup_time, double window_time) {
+    async_executor executor(cfg.executor_threads);
+    AsyncBoundedBuffer<buffer_item> buffer(BUFFER_SIZE, executor);
+    run_state state(num_producers, num_consumers);
+
+    random_device rd;
+    for (int i = 0; i < num_consumers; ++i)
+        executor.spawn(async_consumer(buffer, state, i));
+    for (int i = 0; i < num_producers; ++i)
+        executor.spawn(async_producer(buffer, state, i, rd() ^ static_cast<unsigned>(i)));
+
+    if (warmup_time > 0)
+        this_thread::sleep_for(chrono::duration<double>(warmup_time));
+
+    long base_produced, base_consumed, base_bytes;
+    snapshot_counters(state, &base_produced, &base_consumed, &base_bytes);
+    auto t_start = chrono::steady_clock::now();
+
+    this_thread::sleep_for(chrono::duration<double>(window_time));
+
+    long end_produced, end_consumed, end_bytes;
+    snapshot_counters(state, &end_produced, &end_consumed, &end_bytes);
+    auto t_end = chrono::steady_clock::now();
+
+    // stop: raise the flag, fail every parked push()/pop(), wait for the
+    // coroutines to return
+    state.stop.store(true);
+    buffer.close();
+    executor.join();
+
+    run_result r;
+    r.skipped  = false;
+    r.elapsed  = chrono::duration<double>(t_end - t_start).count();
+    r.produced = end_produced - base_produced;
+    r.consumed = end_consumed - base_consumed;
+    r.consumed_bytes = end_bytes - base_bytes;
+    return r;
+}
+
+// Pick the buffer the configuration asks for and run it
+run_result run_once(const bench_config& cfg, const placement& pl,
+                    int num_producers, int num_consumers,
+                    double warmup_time, double window_time) {
+    typedef BoundedBuffer<buffer_item, BUFFER_SIZE, MutexSemaphorePolicy> mutex_buffer;
+    typedef BoundedBuffer<buffer_item, BUFFER_SIZE, SpscPolicy>           spsc_buffer;
+    typedef BoundedBuffer<buffer_item, BUFFER_SIZE, MpmcPolicy>           mpmc_buffer;
+
+    if (unsupported_reason(cfg, num_producers, num_consumers) != nullptr) {
+        run_result skipped = {true, 0, 0, 0, 0};
+        return skipped;
+    }
+    if (cfg.executor_threads > 0)
+        return run_async(cfg, num_producers, num_consumers, warmup_time, window_time);
+    if (cfg.ring == RING_JOURNAL)
+        return run_with<journal_workload>(cfg, pl, num_producers, num_consumers, warmup_time, window_time);
+    if (cfg.ring == RING_BYTES)
+        return run_with<record_workload>(cfg, pl, num_producers, num_consumers, warmup_time, window_time);
+    if (cfg.shard_option >= 0)
+        return run_with<sharded_workload>(cfg, pl, num_producers, num_consumers, warmup_time, window_time);
+
+    switch (cfg.sync) {
+    case SYNC_SPSC:
+        return run_with<int_workload<spsc_buffer>>(cfg, pl, num_producers, num_consumers, warmup_time, window_time);
+    case SYNC_MPMC:
+        return run_with<int_workload<mpmc_buffer>>(cfg, pl, num_producers, num_consumers, warmup_time, window_time);
+    case SYNC_MUTEX:
+        break;
+    }
+    return run_with<int_workload<mutex_buffer>>(cfg, pl, num_producers, num_consumers, warmup_time, window_time);
+}
+
+
+// Benchmark mode: the full test matrix × every window × every placement,
+// results to CSV and a per-placement summary to stdout
+int run_benchmark(const bench_config& cfg, const char* out_path, double warmup_time,
+                  const vector<double>& windows) {
+    // Same 12 (producers, consumers) pairs as test.sh
+    const int producers[] = {1, 4, 16, 1, 4, 16, 1, 4, 16,  1,  4, 16};
+    const int consumers[] = {1, 1,  1, 2, 2,  2, 4, 4,  4, 16, 16, 16};
+    const int num_cases = sizeof(producers) / sizeof(producers[0]);
+
+    ofstream csv(out_path);
+    if (!csv) {
+        perror(out_path);
+        return 1;
+    }
+    csv << "sleep_s,test_case,producers,consumers,elapsed_s,produced,consumed,throughput,warmup_s,placement,ring,consumed_bytes,shards,steal,sync,executor\n";
+
+    // placement -> (total consumed, total elapsed)
+    map<string, pair<long, double>> per_placement;
+
+    for (const placement& pl : cfg.placements) {
+        for (double w : windows) {
+            for (int tc = 0; tc < num_cases; ++tc) {
+                int p = producers[tc];
+                int c = consumers[tc];
+                run_result r = run_once(cfg, pl, p, c, warmup_time, w);
+                if (r.skipped) {
+                    cout << "[" << pl.name << "] tc=" << (tc + 1) << " p=" << p << " c=" << c
+                         << " skipped: " << unsupported_reason(cfg, p, c) << endl;
+                    continue;
+                }
+                double throughput = r.elapsed > 0 ? r.consumed / r.elapsed : 0;
+
+                csv << w << ',' << (tc + 1) << ',' << p << ',' << c << ','
+                    << r.elapsed << ',' << r.produced << ',' << r.consumed << ','
+                    << throughput << ',' << warmup_time << ',' << pl.name << ','
+                    << ring_kind_name(cfg.ring) << ',' << r.consumed_bytes << ','
+                    << shard_count(cfg, p, c) << ',' << steal_policy_name(cfg.steal) << ','
+                    << sync_kind_name(cfg.sync) << ',' << cfg.executor_threads << '\n';
+                cout << "[" << pl.name << "] tc=" << (tc + 1) << " p=" << p << " c=" << c
+                     << " window=" << w << "s -> " << throughput << " items/sec" << endl;
+
+                per_placement[pl.name].first  += r.consumed;
+                per_placement[pl.name].second += r.elapsed;
+            }
+        }
+    }
+
+    cout << "Throughput per placement:" << endl;
+    for (const placement& pl : cfg.placements) {
+        const auto& totals = per_placement[pl.name];
+        cout << "  " << pl.name << ": "
+             << (totals.second > 0 ? totals.first / totals.second : 0)
+             << " items/sec" << endl;
+    }
+    cout << "Done: results in " << out_path << endl;
+    return 0;
+}
+
+// Fanout mode: 4 producers against each consumer count, once with a
+// pthread per consumer and once with coroutines on the executor
+int run_fanout(const bench_config& cfg, const char* out_path, double window_time,
+               const vector<int>& consumer_counts) {
+    const int num_producers = 4;
+    const double warmup_time = 0.05;
+
+    bench_config threaded = cfg;
+    threaded.executor_threads = 0;
+    bench_config coroutines = cfg;
+    if (coroutines.executor_threads <= 0)
+        coroutines.executor_threads = max(1u, thread::hardware_concurrency());
+
+    ofstream csv(out_path);
+    if (!csv) {
+        perror(out_path);
+        return 1;
+    }
+    csv << "consumers,producers,model,os_threads,elapsed_s,produced,consumed,throughput\n";
+
+    for (int c : consumer_counts) {
+        double throughput[2];
+        for (int model = 0; model < 2; ++model) {
+            bool async = model == 1;
+            run_result r = async
+                ? run_async(coroutines, num_producers, c, warmup_time, window_time)
+                : run_once(threaded, cfg.placements[0], num_producers, c, warmup_time, window_time);
+            int os_threads = async ? coroutines.executor_threads : num_producers + c;
+            throughput[model] = r.elapsed > 0 ? r.consumed / r.elapsed : 0;
+
+            csv << c << ',' << num_producers << ',' << (async ? "coroutine" : "thread") << ','
+                << os_threads << ',' << r.elapsed << ',' << r.produced << ',' << r.consumed << ','
+                << throughput[model] << '\n';
+        }
+        cout << "c=" << c << ": thread-per-worker " << throughput[0]
+             << " items/sec, coroutines on " << coroutines.executor_threads << " threads "
+             << throughput[1] << " items/sec";
+        if (throughput[0] > 0) cout << " (x" << throughput[1] / throughput[0] << ")";
+        cout << endl;
+    }
+    cout << "Done: results in " << out_path << endl;
+    return 0;
+}
+
+#ifdef __linux__
+// Arm a timerfd: first expiry after `seconds`, then every `interval`
+// seconds (0 = one-shot)
+void set_timer(int fd, double seconds, double interval) {
+    itimerspec spec = {};
+    spec.it_value.tv_sec     = static_cast<time_t>(seconds);
+    spec.it_value.tv_nsec    = static_cast<long>((seconds - spec.it_value.tv_sec) * 1e9);
+    spec.it_interval.tv_sec  = static_cast<time_t>(interval);
+    spec.it_interval.tv_nsec = static_cast<long>((interval - spec.it_interval.tv_sec) * 1e9);
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) spec.it_value.tv_nsec = 1;
+    timerfd_settime(fd, 0, &spec, nullptr);
+}
+
+// Epoll mode: a producer thread per buffer, one consumer thread draining
+// every buffer from a single epoll loop next to two timerfds
+template <typename SyncPolicy>
+int run_epoll(double seconds, int num_buffers, size_t capacity, size_t batch_size) {
+    typedef PollableBuffer<buffer_item, dynamic_capacity, SyncPolicy> buffer_type;
+
+    vector<unique_ptr<buffer_type>> buffers;
+    for (int i = 0; i < num_buffers; ++i) {
+        buffers.emplace_back(new buffer_type(capacity));
+        if (!buffers.back()->valid()) {
+            perror("eventfd");
+            return 1;
+        }
+    }
+
+    // epoll ids: 0..n-1 buffers, then the two timers
+    const uint64_t TICK_ID = num_buffers, DEADLINE_ID = num_buffers + 1;
+    int ep       = epoll_create1(EPOLL_CLOEXEC);
+    int tick     = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    int deadline = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (ep == -1 || tick == -1 || deadline == -1) {
+        perror("epoll/timerfd");
+        return 1;
+    }
+    auto watch = [&](int fd, uint64_t id) {
+        epoll_event ev = {};
+        ev.events   = EPOLLIN;
+        ev.data.u64 = id;
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+    };
+    for (int i = 0; i < num_buffers; ++i) watch(buffers[i]->readable_fd(), i);
+    watch(tick, TICK_ID);
+    watch(deadline, DEADLINE_ID);
+
+    // producers: push until full, then sleep on the buffer's writable fd
+    atomic<bool> stop(false);
+    vector<thread_counter> produced(num_buffers);
+    random_device rd;
+    vector<thread> producers;
+    for (int i = 0; i < num_buffers; ++i) {
+        unsigned seed = rd() ^ static_cast<unsigned>(i);
+        producers.emplace_back([&, i, seed] {
+            buffer_type& buffer = *buffers[i];
+            minstd_rand rng(seed);
+            uniform_int_distribution<buffer_item> dist(1, 5);
+            pollfd pfd = {buffer.writable_fd(), POLLIN, 0};
+            while (!stop.load(memory_order_relaxed)) {
+                buffer_item item = dist(rng);
+                if (buffer.try_push(std::move(item))) {
+                    produced[i].add(1);
+                    continue;
+                }
+                if (buffer.is_closed()) break;
+                poll(&pfd, 1, -1);
+                buffer.clear_writable();
+            }
+        });
+    }
+
+    set_timer(tick, 0.1, 0.1);
+    set_timer(deadline, seconds, 0);
+    auto t_start = chrono::steady_clock::now();
+    double elapsed = 0;
+
+    // consumer: one epoll loop over every buffer and both timers; runs
+    // until every buffer is closed and drained
+    long consumed = 0, counted = 0, wakeups = 0, drains = 0, ticks = 0;
+    int open_buffers = num_buffers;
+    vector<epoll_event> events(64);
+    while (open_buffers > 0) {
+        int n = epoll_wait(ep, events.data(), static_cast<int>(events.size()), -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        ++wakeups;
+        for (int e = 0; e < n; ++e) {
+            uint64_t id = events[e].data.u64;
+            uint64_t expirations;
+            if (id == TICK_ID) {
+                if (read(tick, &expirations, sizeof(expirations)) > 0) ticks += expirations;
+            } else if (id == DEADLINE_ID) {
+                if (read(deadline, &expirations, sizeof(expirations)) < 0) continue;
+                elapsed = chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+                counted = consumed;
+                stop.store(true);
+                for (auto& b : buffers) b->close();
+            } else {
+                buffer_type& b = *buffers[id];
+                size_t got = b.drain([&](buffer_item&) { ++consumed; }, batch_size);
+                ++drains;
+                // closed and emptied: nothing more can arrive
+                if (b.is_closed() && got < batch_size) {
+                    epoll_ctl(ep, EPOLL_CTL_DEL, b.readable_fd(), nullptr);
+                    --open_buffers;
+                }
+            }
+        }
+    }
+    for (auto& t : producers) t.join();
+    close(deadline);
+    close(tick);
+    close(ep);
+
+    long total_produced = 0, readable_signals = 0, writable_signals = 0;
+    for (auto& c : produced) total_produced += c.value.load();
+    for (auto& b : buffers) {
+        long r, w;
+        b->counters(&r, &w);
+        readable_signals += r;
+        writable_signals += w;
+    }
 
-    // report
     cout << "Total items produced: " << total_produced << endl;
-    cout << "Total items consumed: " << total_consumed << endl;
+    cout << "Total items consumed: " << counted << endl;
     cout << "Elapsed time: " << elapsed << " seconds" << endl;
+    cout << "Throughput: " << (elapsed > 0 ? counted / elapsed : 0) << " items/sec" << endl;
+    cout << "epoll_wait wakeups: " << wakeups << " (" << (wakeups ? consumed / (double)wakeups : 0)
+         << " items each), buffer drains: " << drains << endl;
+    cout << "eventfd signals: " << readable_signals << " readable, " << writable_signals
+         << " writable (" << (readable_signals + writable_signals
+                              ? consumed / (double)(readable_signals + writable_signals) : 0)
+         << " items each)" << endl;
+    cout << "Timer ticks: " << ticks << endl;
+    return 0;
+}
+#endif
+
+// Durability mode: 4 producers / 4 consumers through a fresh journal for
+// every commit interval (time-based commits only)
+int run_durability(const bench_config& cfg, const char* out_path, double window_time,
+                   const vector<double>& intervals) {
+    const int num_producers = 4, num_consumers = 4;
+    const double warmup_time = 0.05;
+
+    ofstream csv(out_path);
+    if (!csv) {
+        perror(out_path);
+        return 1;
+    }
+    csv << "commit_interval_s,producers,consumers,elapsed_s,produced,consumed,throughput,commits,avg_msync_ms,synced_bytes\n";
+
+    for (double interval : intervals) {
+        bench_config run_cfg = cfg;
+        run_cfg.ring = RING_JOURNAL;
+        run_cfg.journal_keep = false;
+        run_cfg.journal.commit_interval = interval;
+        run_cfg.journal.commit_bytes    = 0;
+
+        run_result r = run_with<journal_workload>(run_cfg, cfg.placements[0], num_producers, num_consumers,
+                                                  warmup_time, window_time);
+        const journal_stats& js = r.journal;
+        double throughput = r.elapsed > 0 ? r.consumed / r.elapsed : 0;
+        double avg_sync   = js.commits ? 1000.0 * js.sync_seconds / js.commits : 0;
+
+        csv << interval << ',' << num_producers << ',' << num_consumers << ',' << r.elapsed << ','
+            << r.produced << ',' << r.consumed << ',' << throughput << ',' << js.commits << ','
+            << avg_sync << ',' << js.synced_bytes << '\n';
+        cout << "commit every " << interval << "s -> " << throughput << " items/sec, "
+             << js.commits << " commits, " << avg_sync << " ms msync each" << endl;
+    }
+    journal::remove(cfg.journal_dir);
+    cout << "Done: results in " << out_path << endl;
+    return 0;
+}
+
+// Record carried through the pipeline demo
+struct pipeline_record {
+    uint64_t id;
+    char     raw[24];    // written by the producer
+    uint64_t value;      // parsed from raw
+    uint64_t digest;     // computed by enrich
+};
+
+// Pipeline mode: producer -> parse -> enrich -> sink with the given
+// thread count per stage
+template <typename SyncPolicy>
+int run_pipeline(double seconds, const vector<int>& threads, size_t batch_size,
+                 const char* occupancy_path) {
+    Pipeline<pipeline_record, SyncPolicy> pipe(16, batch_size);
+    atomic<uint64_t> next_id(0);
+    atomic<uint64_t> checksum(0);
+
+    pipe.add_stage("producer", threads[0], [&](vector<pipeline_record>& batch) {
+            uint64_t first = next_id.fetch_add(batch_size, memory_order_relaxed);
+            batch.resize(batch_size);
+            for (size_t i = 0; i < batch_size; ++i) {
+                batch[i].id = first + i;
+                snprintf(batch[i].raw, sizeof(batch[i].raw), "%llu",
+                         static_cast<unsigned long long>(first + i));
+            }
+            return true;
+        })
+        .add_stage("parse", threads[1], [](vector<pipeline_record>& batch) {
+            for (auto& rec : batch) rec.value = strtoull(rec.raw, nullptr, 10);
+            return true;
+        })
+        .add_stage("enrich", threads[2], [](vector<pipeline_record>& batch) {
+            for (auto& rec : batch) {
+                uint64_t h = rec.value;
+                for (int round = 0; round < 64; ++round)
+                    h = (h ^ (h >> 31)) * 0x9E3779B97F4A7C15ULL;
+                rec.digest = h;
+            }
+            return true;
+        })
+        .add_stage("sink", threads[3], [&](vector<pipeline_record>& batch) {
+            uint64_t sum = 0;
+            for (const auto& rec : batch) sum += rec.digest;
+            checksum.fetch_add(sum, memory_order_relaxed);
+            return true;
+        });
+
+    pipeline_report r = pipe.run(seconds);
+    print_pipeline_report(r, cout);
+    cout << "Checksum: " << checksum.load() << endl;
+
+    if (occupancy_path != nullptr) {
+        ofstream csv(occupancy_path);
+        if (!csv) {
+            perror(occupancy_path);
+            return 1;
+        }
+        write_occupancy_csv(r, csv);
+        cout << "Occupancy samples in " << occupancy_path << endl;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    bench_config cfg;
+
+    // pull out the --option pairs, keep the positional arguments
+    vector<char*> args;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--placement") == 0 && i + 1 < argc) {
+            placement pl;
+            if (!parse_placement(argv[++i], &pl)) {
+                cerr << "unknown placement: " << argv[i] << endl;
+                return 1;
+            }
+            cfg.placements.push_back(pl);
+        } else if (strcmp(argv[i], "--ring") == 0 && i + 1 < argc) {
+            if (!parse_ring_kind(argv[++i], &cfg.ring)) {
+                cerr << "unknown ring: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--journal-dir") == 0 && i + 1 < argc) {
+            cfg.journal_dir = argv[++i];
+        } else if (strcmp(argv[i], "--commit-interval") == 0 && i + 1 < argc) {
+            cfg.journal.commit_interval = max(0.0, atof(argv[++i]));
+        } else if (strcmp(argv[i], "--commit-bytes") == 0 && i + 1 < argc) {
+            cfg.journal.commit_bytes = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--sync") == 0 && i + 1 < argc) {
+            if (!parse_sync_kind(argv[++i], &cfg.sync)) {
+                cerr << "unknown sync policy: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+            cfg.shard_option = max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--steal") == 0 && i + 1 < argc) {
+            if (!parse_steal_policy(argv[++i], &cfg.steal)) {
+                cerr << "unknown steal policy: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--executor") == 0 && i + 1 < argc) {
+            cfg.executor_threads = max(1, atoi(argv[++i]));
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (cfg.placements.empty()) cfg.placements.push_back(placement());
+    if (cfg.ring != RING_INT && cfg.shard_option >= 0) {
+        cerr << "--shards only applies to the int ring" << endl;
+        return 1;
+    }
+    if (cfg.executor_threads > 0 && (cfg.ring != RING_INT || cfg.shard_option >= 0 || cfg.sync != SYNC_MUTEX)) {
+        cerr << "--executor runs its own buffer; drop --ring, --shards and --sync" << endl;
+        return 1;
+    }
+    argc = static_cast<int>(args.size());
+    argv = args.data();
+
+    cfg.topology = read_topology();
+
+    if (argc >= 3 && strcmp(argv[1], "--bench") == 0) {
+        double warmup_time = argc >= 4 ? atof(argv[3]) : 0.05;
+        vector<double> windows;
+        for (int i = 4; i < argc; ++i) windows.push_back(atof(argv[i]));
+        if (windows.empty()) windows = {0.0001, 0.001, 0.01, 0.1, 1.0};
+        return run_benchmark(cfg, argv[2], warmup_time, windows);
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--fanout") == 0) {
+        // both models must run the same 5-slot mutex buffer
+        if (cfg.ring != RING_INT || cfg.shard_option >= 0 || cfg.sync != SYNC_MUTEX) {
+            cerr << "--fanout compares against the coroutine buffer; drop --ring, --shards and --sync" << endl;
+            return 1;
+        }
+        double window_time = argc >= 4 ? atof(argv[3]) : 1.0;
+        vector<int> counts;
+        for (int i = 4; i < argc; ++i) counts.push_back(max(1, atoi(argv[i])));
+        if (counts.empty()) counts = {1, 16, 64, 256, 1024, 4096};
+        return run_fanout(cfg, argv[2], window_time, counts);
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--durability") == 0) {
+        double window_time = argc >= 4 ? atof(argv[3]) : 1.0;
+        vector<double> intervals;
+        for (int i = 4; i < argc; ++i) intervals.push_back(atof(argv[i]));
+        if (intervals.empty()) intervals = {0.0001, 0.001, 0.01, 0.1};
+        return run_durability(cfg, argv[2], window_time, intervals);
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "--epoll") == 0) {
+#ifdef __linux__
+        double seconds    = atof(argv[2]);
+        int    num_buffers = max(1, atoi(argv[3]));
+        size_t capacity   = argc >= 5 ? max(1, atoi(argv[4])) : BUFFER_SIZE;
+        size_t batch_size = argc >= 6 ? max(1, atoi(argv[5])) : 64;
+
+        cout << "Parameters -> seconds: " << seconds
+             << ", buffers: "  << num_buffers
+             << ", capacity: " << capacity
+             << ", batch: "    << batch_size
+             << ", sync: "     << sync_kind_name(cfg.sync) << endl;
+
+        switch (cfg.sync) {
+        case SYNC_SPSC:
+            return run_epoll<SpscPolicy>(seconds, num_buffers, capacity, batch_size);
+        case SYNC_MPMC:
+            if (capacity < 2) {
+                cerr << "mpmc buffers need a capacity of at least 2" << endl;
+                return 1;
+            }
+            return run_epoll<MpmcPolicy>(seconds, num_buffers, capacity, batch_size);
+        case SYNC_MUTEX:
+            break;
+        }
+        return run_epoll<MutexSemaphorePolicy>(seconds, num_buffers, capacity, batch_size);
+#else
+        cerr << "--epoll needs Linux (eventfd, epoll, timerfd)" << endl;
+        return 1;
+#endif
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "--pipeline") == 0) {
+        double seconds = atof(argv[2]);
+        vector<int> threads;
+        for (const char* p = argv[3]; *p; ) {
+            threads.push_back(max(1, atoi(p)));
+            p = strchr(p, ',');
+            if (p == nullptr) break;
+            ++p;
+        }
+        if (threads.size() != 4) {
+            cerr << "--pipeline needs four thread counts: producer,parse,enrich,sink" << endl;
+            return 1;
+        }
+        size_t batch_size = argc >= 5 ? max(1, atoi(argv[4])) : 64;
+        const char* occupancy_path = argc >= 6 ? argv[5] : nullptr;
+
+        switch (cfg.sync) {
+        case SYNC_SPSC:
+            if (*max_element(threads.begin(), threads.end()) > 1) {
+                cerr << "spsc queues need one thread per stage" << endl;
+                return 1;
+            }
+            return run_pipeline<SpscPolicy>(seconds, threads, batch_size, occupancy_path);
+        case SYNC_MPMC:
+            return run_pipeline<MpmcPolicy>(seconds, threads, batch_size, occupancy_path);
+        case SYNC_MUTEX:
+            break;
+        }
+        return run_pipeline<MutexSemaphorePolicy>(seconds, threads, batch_size, occupancy_path);
+    }
+
+    if (argc != 4) return 1;
+
+    // parse args (now supports fractional seconds)
+    double sleep_time    = atof(argv[1]);
+    int    num_producers = atoi(argv[2]);
+    int    num_consumers = atoi(argv[3]);
+
+    cout << "Parameters -> sleep_time: " << sleep_time
+         << ", producers: "  << num_producers
+         << ", consumers: "  << num_consumers
+         << ", placement: "  << cfg.placements[0].name
+         << ", ring: "       << ring_kind_name(cfg.ring)
+         << ", sync: "       << sync_kind_name(cfg.sync)
+         << ", shards: "     << shard_count(cfg, num_producers, num_consumers)
+         << ", steal: "      << steal_policy_name(cfg.steal)
+         << ", executor: "   << cfg.executor_threads << endl;
+
+    cfg.journal_keep = true;
+    run_result r = run_once(cfg, cfg.placements[0], num_producers, num_consumers, 0.0, sleep_time);
+    if (r.skipped) {
+        cerr << unsupported_reason(cfg, num_producers, num_consumers) << endl;
+        return 1;
+    }
+
+    // report
+    cout << "Total items produced: " << r.produced << endl;
+    cout << "Total items consumed: " << r.consumed << endl;
+    cout << "Total bytes consumed: " << r.consumed_bytes << endl;
+    cout << "Elapsed time: " << r.elapsed << " seconds" << endl;
     cout << "Throughput: "
-         << (total_consumed / elapsed)
+         << (r.consumed / r.elapsed)
          << " items/sec" << endl;
-
-    // cleanup
-    cleanup_shared_memory();
-    pthread_mutex_destroy(&mutex_lock);
-    sem_destroy(&sem_empty);
-    sem_destroy(&full);
+    if (cfg.ring == RING_JOURNAL) {
+        const journal_stats& js = r.journal;
+        cout << "Group commits: " << js.commits << ", "
+             << (js.commits ? 1000.0 * js.sync_seconds / js.commits : 0) << " ms msync each, "
+             << js.synced_bytes << " bytes synced" << endl;
+    }
 
     return 0;
 }
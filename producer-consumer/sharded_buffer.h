@@ -0,0 +1,237 @@
+/**************************************************************
+ * sharded_buffer.h
+ * Bounded buffer split into K independent sub-rings (shards).
+ *
+ * Each shard is a small circular buffer with its own mutex and
+ * condition variables, on its own cache lines. Producers are bound
+ * to one shard; consumers drain a home shard first and, depending on
+ * the steal policy, take work from the other shards when it is empty:
+ *
+ *   STEAL_NONE  - consumers only ever see their home shard. FIFO holds
+ *                 per shard, but a shard without producers starves its
+ *                 consumers.
+ *   STEAL_ONE   - when home is empty, take one item from the first
+ *                 other shard that has any (checked with trylock so a
+ *                 busy shard is skipped, not waited on).
+ *   STEAL_HALF  - like STEAL_ONE, but move up to half of the victim's
+ *                 items into the consumer's private steal_cache in one
+ *                 lock acquisition. Fewest lock round trips, loosest
+ *                 ordering.
+ *
+ * A single shard with STEAL_NONE behaves like the original buffer
+ * (strict FIFO). More shards and more aggressive stealing trade
+ * ordering for less contention.
+ *
+ * Wakeups are only signalled when someone is actually waiting, so the
+ * uncontended path makes no futex calls. Consumers that steal wait on
+ * their home shard with a short timeout and then rescan.
+ **************************************************************/
+#ifndef SHARDED_BUFFER_H
+#define SHARDED_BUFFER_H
+
+#include <pthread.h>
+#include <ctime>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+
+enum steal_policy { STEAL_NONE, STEAL_ONE, STEAL_HALF };
+
+// Parse "none", "one" or "half"
+inline bool parse_steal_policy(const std::string& text, steal_policy* out) {
+    if (text == "none")      *out = STEAL_NONE;
+    else if (text == "one")  *out = STEAL_ONE;
+    else if (text == "half") *out = STEAL_HALF;
+    else return false;
+    return true;
+}
+
+inline const char* steal_policy_name(steal_policy policy) {
+    switch (policy) {
+    case STEAL_NONE: return "none";
+    case STEAL_ONE:  return "one";
+    case STEAL_HALF: return "half";
+    }
+    return "?";
+}
+
+// Items a consumer has stolen but not yet processed
+typedef std::deque<int> steal_cache;
+
+class sharded_buffer {
+public:
+    // How long a stealing consumer sleeps on an empty home before rescanning
+    static const long RESCAN_NS = 200 * 1000;
+
+    sharded_buffer(int num_shards, int shard_capacity, steal_policy policy)
+        : shards(num_shards), capacity(shard_capacity), policy(policy) {
+        for (shard& s : shards) {
+            pthread_mutex_init(&s.lock, nullptr);
+            pthread_cond_init(&s.not_full, nullptr);
+            pthread_cond_init(&s.not_empty, nullptr);
+            s.slots.assign(capacity, -1);
+        }
+    }
+
+    ~sharded_buffer() {
+        for (shard& s : shards) {
+            pthread_cond_destroy(&s.not_empty);
+            pthread_cond_destroy(&s.not_full);
+            pthread_mutex_destroy(&s.lock);
+        }
+    }
+
+    sharded_buffer(const sharded_buffer&) = delete;
+    sharded_buffer& operator=(const sharded_buffer&) = delete;
+
+    int num_shards() const { return static_cast<int>(shards.size()); }
+
+    // Append to shard `index`, blocking while it is full.
+    // Returns false once the buffer has been shut down.
+    bool insert(int index, int item) {
+        shard& s = shards[index];
+        pthread_mutex_lock(&s.lock);
+        while (s.count == capacity && !s.stopped) {
+            ++s.producers_waiting;
+            pthread_cond_wait(&s.not_full, &s.lock);
+            --s.producers_waiting;
+        }
+        if (s.stopped) {
+            pthread_mutex_unlock(&s.lock);
+            return false;
+        }
+
+        s.slots[(s.head + s.count) % capacity] = item;
+        ++s.count;
+        ++s.produced;
+        if (s.consumers_waiting) pthread_cond_signal(&s.not_empty);
+        pthread_mutex_unlock(&s.lock);
+        return true;
+    }
+
+    // Take the next item for a consumer whose home shard is `home`:
+    // stolen items first, then home, then other shards per the policy.
+    // Blocks while there is nothing to take; returns false on shutdown.
+    bool remove(int home, steal_cache* cache, int* item) {
+        if (!cache->empty()) {
+            *item = cache->front();
+            cache->pop_front();
+            return true;
+        }
+
+        shard& h = shards[home];
+        while (true) {
+            pthread_mutex_lock(&h.lock);
+            if (h.stopped) {
+                pthread_mutex_unlock(&h.lock);
+                return false;
+            }
+            if (h.count > 0) {
+                *item = take_locked(h);
+                pthread_mutex_unlock(&h.lock);
+                return true;
+            }
+            pthread_mutex_unlock(&h.lock);
+
+            if (policy != STEAL_NONE && steal(home, cache, item)) return true;
+
+            // nothing anywhere: sleep on home (bounded when stealing)
+            pthread_mutex_lock(&h.lock);
+            if (h.count == 0 && !h.stopped) {
+                ++h.consumers_waiting;
+                if (policy == STEAL_NONE) {
+                    pthread_cond_wait(&h.not_empty, &h.lock);
+                } else {
+                    timespec deadline;
+                    clock_gettime(CLOCK_REALTIME, &deadline);
+                    deadline.tv_nsec += RESCAN_NS;
+                    if (deadline.tv_nsec >= 1000000000L) {
+                        deadline.tv_sec  += 1;
+                        deadline.tv_nsec -= 1000000000L;
+                    }
+                    pthread_cond_timedwait(&h.not_empty, &h.lock, &deadline);
+                }
+                --h.consumers_waiting;
+            }
+            pthread_mutex_unlock(&h.lock);
+        }
+    }
+
+    // Wake every blocked thread and make insert()/remove() fail from now on
+    void shutdown() {
+        for (shard& s : shards) {
+            pthread_mutex_lock(&s.lock);
+            s.stopped = true;
+            pthread_cond_broadcast(&s.not_full);
+            pthread_cond_broadcast(&s.not_empty);
+            pthread_mutex_unlock(&s.lock);
+        }
+    }
+
+    // Items inserted / removed over all shards
+    void counters(long* produced, long* consumed) {
+        *produced = 0;
+        *consumed = 0;
+        for (shard& s : shards) {
+            pthread_mutex_lock(&s.lock);
+            *produced += s.produced;
+            *consumed += s.consumed;
+            pthread_mutex_unlock(&s.lock);
+        }
+    }
+
+private:
+    struct alignas(64) shard {
+        pthread_mutex_t lock;
+        pthread_cond_t  not_full;
+        pthread_cond_t  not_empty;
+        std::vector<int> slots;
+        int  head = 0;
+        int  count = 0;
+        int  producers_waiting = 0;
+        int  consumers_waiting = 0;
+        bool stopped = false;
+        long produced = 0;
+        long consumed = 0;
+    };
+
+    // Pop the oldest item of a locked, non-empty shard
+    int take_locked(shard& s) {
+        int item = s.slots[s.head];
+        s.head = (s.head + 1) % capacity;
+        --s.count;
+        ++s.consumed;
+        if (s.producers_waiting) pthread_cond_signal(&s.not_full);
+        return item;
+    }
+
+    // Scan the other shards, skipping any that are locked right now
+    bool steal(int home, steal_cache* cache, int* item) {
+        int n = num_shards();
+        for (int off = 1; off < n; ++off) {
+            shard& v = shards[(home + off) % n];
+            if (pthread_mutex_trylock(&v.lock) != 0) continue;
+            if (v.count == 0) {
+                pthread_mutex_unlock(&v.lock);
+                continue;
+            }
+
+            *item = take_locked(v);
+            if (policy == STEAL_HALF) {
+                int extra = v.count / 2;
+                for (int i = 0; i < extra; ++i) cache->push_back(take_locked(v));
+                if (extra && v.producers_waiting) pthread_cond_broadcast(&v.not_full);
+            }
+            pthread_mutex_unlock(&v.lock);
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<shard> shards;
+    int capacity;
+    steal_policy policy;
+};
+
+#endif // SHARDED_BUFFER_H